@@ -0,0 +1,257 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <source_location>
+
+//Recording is compiled in with VECTOR_CAPACITY_PROFILE=1, defined the same way in every
+//translation unit. Without it Vectors carry no profiling state; tagged Vectors still
+//reserve what a load()ed profile suggests but record nothing.
+#if !defined(VECTOR_CAPACITY_PROFILE)
+#define VECTOR_CAPACITY_PROFILE 0
+#endif
+
+//Opt-in capacity learning. A Vector built from capacity_profile::here() reports its
+//peak and final size to a histogram for that call site when it dies. Later
+//Vectors from the same site reserve the learned percentile of the peak sizes up front.
+//Sites live in a fixed table claimed with compare-and-swap, histograms are plain
+//atomic counters, so recording never takes a lock.
+namespace capacity_profile {
+
+constexpr std::size_t kMaxSites = 512;
+constexpr std::size_t kBuckets = 256;
+constexpr std::size_t kNameLength = 192;
+
+//Four buckets per power of two, so a learned reservation overshoots by at most 25%
+inline std::size_t bucket_of(std::size_t size) {
+  if (size < 4)
+    return size;
+  std::size_t exponent = 63;
+  while (!(size >> exponent))
+    exponent--;
+  return 4 * (exponent - 1) + ((size >> (exponent - 2)) & 3);
+}
+
+inline std::size_t bucket_limit(std::size_t bucket) {
+  if (bucket < 4)
+    return bucket;
+  std::size_t exponent = bucket / 4 + 1;
+  std::size_t sub = bucket % 4;
+  if (exponent >= 63)
+    return static_cast<std::size_t>(-1);
+  return ((4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+inline std::uint64_t hash_location(const char* file, std::uint32_t line, std::uint32_t column) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (; *file; file++)
+    hash = (hash ^ static_cast<unsigned char>(*file)) * 1099511628211ull;
+  hash = (hash ^ line) * 1099511628211ull;
+  hash = (hash ^ column) * 1099511628211ull;
+  return hash ? hash : 1;
+}
+
+struct Settings {
+  std::atomic<unsigned> percentile{90};
+  std::atomic<std::uint64_t> min_samples{8};
+};
+
+inline Settings& settings() {
+  static Settings instance;
+  return instance;
+}
+
+//Percentile of peak sizes a site reserves, 1..100
+inline void set_percentile(unsigned percentile) {
+  settings().percentile.store(percentile < 1 ? 1 : percentile > 100 ? 100 : percentile);
+}
+
+//Samples a site needs before it starts reserving
+inline void set_min_samples(std::uint64_t samples) {
+  settings().min_samples.store(samples);
+}
+
+struct Site {
+  void record(std::size_t peak_size, std::size_t final_size) {
+    peak[bucket_of(peak_size)].fetch_add(1, std::memory_order_relaxed);
+    final[bucket_of(final_size)].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //Capacity to reserve for a new Vector from this site, 0 until enough samples are in
+  std::size_t suggested_capacity() const {
+    std::uint64_t count = samples.load(std::memory_order_relaxed);
+    if (!count || count < settings().min_samples.load(std::memory_order_relaxed))
+      return 0;
+    std::uint64_t wanted = (count * settings().percentile.load(std::memory_order_relaxed) + 99) / 100;
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < kBuckets; bucket++) {
+      seen += peak[bucket].load(std::memory_order_relaxed);
+      if (seen >= wanted)
+        return bucket_limit(bucket);
+    }
+    return 0;
+  }
+
+  std::atomic<std::uint64_t> key{0};
+  std::atomic<bool> ready{false};
+  char name[kNameLength];
+  std::atomic<std::uint64_t> samples{0};
+  std::atomic<std::uint64_t> peak[kBuckets];
+  std::atomic<std::uint64_t> final[kBuckets];
+};
+
+inline Site* sites() {
+  static Site table[kMaxSites];
+  return table;
+}
+
+//Open addressing over the site table. Returns nullptr once the table is full.
+inline Site* find_site(const char* file, std::uint32_t line, std::uint32_t column) {
+  std::uint64_t key = hash_location(file, line, column);
+  Site* table = sites();
+  for (std::size_t probe = 0; probe < kMaxSites; probe++) {
+    Site& site = table[(key + probe) % kMaxSites];
+    std::uint64_t current = site.key.load(std::memory_order_acquire);
+    if (!current && site.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      std::snprintf(site.name, kNameLength, "%s:%u:%u", file, static_cast<unsigned>(line), static_cast<unsigned>(column));
+      site.ready.store(true, std::memory_order_release);
+      return &site;
+    }
+    if (current == key)
+      return &site;
+  }
+  return nullptr;
+}
+
+//Pass to a Vector constructor to profile that call site
+struct Tag {
+  Site* site;
+};
+
+inline Tag here(const std::source_location& location = std::source_location::current()) {
+  return Tag{ find_site(location.file_name(), location.line(), location.column()) };
+}
+
+#if VECTOR_CAPACITY_PROFILE
+//Per-Vector profiling state: the site and the peak size seen so far
+class Tracker {
+public:
+  void attach(Site* site) noexcept {
+    _site = site;
+  }
+
+  //Called before the size drops
+  void note(std::size_t size) noexcept {
+    if (_site && size > _peak)
+      _peak = size;
+  }
+
+  void finish(std::size_t size) noexcept {
+    if (_site)
+      _site->record(size > _peak ? size : _peak, size);
+  }
+
+private:
+  Site* _site = nullptr;
+  std::size_t _peak = 0;
+};
+#else
+//Empty, Vector holds it as a no_unique_address member
+class Tracker {
+public:
+  void attach(Site*) noexcept {}
+  void note(std::size_t) noexcept {}
+  void finish(std::size_t) noexcept {}
+};
+#endif
+
+//One line per site: name, sample count, then bucket:count pairs for peak and final sizes
+inline bool dump(const char* path) {
+  std::FILE* file = std::fopen(path, "w");
+  if (!file)
+    return false;
+  Site* table = sites();
+  for (std::size_t i = 0; i < kMaxSites; i++) {
+    Site& site = table[i];
+    if (!site.ready.load(std::memory_order_acquire))
+      continue;
+    std::fprintf(file, "%s %llu peak", site.name, static_cast<unsigned long long>(site.samples.load()));
+    for (std::size_t bucket = 0; bucket < kBuckets; bucket++)
+      if (std::uint64_t count = site.peak[bucket].load(std::memory_order_relaxed))
+        std::fprintf(file, " %zu:%llu", bucket, static_cast<unsigned long long>(count));
+    std::fprintf(file, " final");
+    for (std::size_t bucket = 0; bucket < kBuckets; bucket++)
+      if (std::uint64_t count = site.final[bucket].load(std::memory_order_relaxed))
+        std::fprintf(file, " %zu:%llu", bucket, static_cast<unsigned long long>(count));
+    std::fprintf(file, "\n");
+  }
+  return std::fclose(file) == 0;
+}
+
+//Adds the histograms of a dump file to the current profile
+inline bool load(const char* path) {
+  std::FILE* file = std::fopen(path, "r");
+  if (!file)
+    return false;
+
+  char line[2 * kBuckets * 48 + kNameLength];
+  bool ok = true;
+  while (std::fgets(line, sizeof(line), file)) {
+    char* name = std::strtok(line, " \n");
+    char* samples = std::strtok(nullptr, " \n");
+    char* column_sep = name ? std::strrchr(name, ':') : nullptr;
+    if (!samples || !column_sep) {
+      ok = false;
+      continue;
+    }
+    *column_sep = '\0';
+    char* line_sep = std::strrchr(name, ':');
+    if (!line_sep) {
+      ok = false;
+      continue;
+    }
+    *line_sep = '\0';
+    Site* site = find_site(
+      name,
+      static_cast<std::uint32_t>(std::strtoul(line_sep + 1, nullptr, 10)),
+      static_cast<std::uint32_t>(std::strtoul(column_sep + 1, nullptr, 10))
+    );
+    if (!site)
+      continue;
+
+    std::atomic<std::uint64_t>* histogram = nullptr;
+    for (char* word = std::strtok(nullptr, " \n"); word; word = std::strtok(nullptr, " \n")) {
+      if (!std::strcmp(word, "peak"))
+        histogram = site->peak;
+      else if (!std::strcmp(word, "final"))
+        histogram = site->final;
+      else {
+        std::size_t bucket = 0;
+        unsigned long long count = 0;
+        if (std::sscanf(word, "%zu:%llu", &bucket, &count) == 2 && histogram && bucket < kBuckets)
+          histogram[bucket].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+    site->samples.fetch_add(std::strtoull(samples, nullptr, 10), std::memory_order_relaxed);
+  }
+  std::fclose(file);
+  return ok;
+}
+
+//Forgets every histogram. Not safe while profiled Vectors are alive.
+inline void reset() {
+  Site* table = sites();
+  for (std::size_t i = 0; i < kMaxSites; i++) {
+    Site& site = table[i];
+    site.samples.store(0);
+    for (std::size_t bucket = 0; bucket < kBuckets; bucket++) {
+      site.peak[bucket].store(0);
+      site.final[bucket].store(0);
+    }
+  }
+}
+
+}
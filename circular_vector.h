@@ -0,0 +1,343 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//Double-ended queue in one ring buffer. Elements live at [head, head + size) modulo the
+//capacity, so pushing and popping at either end never moves the others. The ring is a
+//Vector whose slots are all constructed, as in GapBuffer: free slots hold
+//value-initialized T, so T must be default constructible. Growth inserts free slots
+//behind the last element through Vector::insert, which allocates and relocates.
+//With Overflow::OverwriteOldest the capacity is fixed and a push into a full ring
+//replaces the element at the opposite end, which suits bounded telemetry history.
+template<class T, class Allocator = std::allocator<T>>
+class CircularVector {
+  static_assert(std::is_default_constructible<T>::value, "CircularVector needs a default constructible type");
+
+public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = typename std::allocator_traits<Allocator>::pointer;
+  using iterator = IndexIterator<CircularVector, T>;
+  using const_iterator = IndexIterator<const CircularVector, const T>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  enum class Overflow { Grow, OverwriteOldest };
+
+  CircularVector() noexcept(noexcept(Allocator()))
+    : _head(0), _size(0), _overflow(Overflow::Grow) {}
+
+  explicit CircularVector(size_type capacity, Overflow overflow = Overflow::Grow, const Allocator& alloc = Allocator())
+    : _buffer(alloc), _head(0), _size(0), _overflow(overflow) {
+    if (overflow == Overflow::OverwriteOldest && !capacity)
+      throw std::length_error("Bounded CircularVector needs a capacity");
+    _buffer.resize(capacity);
+  }
+
+  CircularVector(std::initializer_list<T> init, const Allocator& alloc = Allocator())
+    : CircularVector(init.size(), Overflow::Grow, alloc) {
+    for (const T& value : init)
+      push_back(value);
+  }
+
+  CircularVector(const CircularVector& other) = default;
+
+  CircularVector(CircularVector&& other) noexcept
+    : _buffer(std::move(other._buffer)), _head(other._head), _size(other._size), _overflow(other._overflow) {
+    other._head = 0;
+    other._size = 0;
+  }
+
+  CircularVector& operator=(const CircularVector& other) {
+    if (this != &other) {
+      CircularVector copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  CircularVector& operator=(CircularVector&& other) noexcept {
+    CircularVector moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  //Element access
+  reference operator[](size_type pos) noexcept {
+    return _buffer[physical(pos)];
+  }
+
+  const_reference operator[](size_type pos) const noexcept {
+    return _buffer[physical(pos)];
+  }
+
+  reference at(size_type pos) {
+    if (pos >= _size)
+      throw std::out_of_range("CircularVector subscript out of range");
+    return (*this)[pos];
+  }
+
+  const_reference at(size_type pos) const {
+    if (pos >= _size)
+      throw std::out_of_range("CircularVector subscript out of range");
+    return (*this)[pos];
+  }
+
+  reference front() noexcept {
+    return _buffer[_head];
+  }
+
+  const_reference front() const noexcept {
+    return _buffer[_head];
+  }
+
+  reference back() noexcept {
+    return (*this)[_size - 1];
+  }
+
+  const_reference back() const noexcept {
+    return (*this)[_size - 1];
+  }
+
+  //Unwraps the ring so the elements sit at [data, data + size) and returns data.
+  //Free when they already do, otherwise one rotation of the buffer.
+  T* linearize() {
+    if (!_size)
+      _head = 0;
+    else if (!is_linearized()) {
+      std::rotate(_buffer.begin(), _buffer.begin() + _head, _buffer.end());
+      _head = 0;
+    }
+    return _buffer.data() + _head;
+  }
+
+  //True when linearize() would not move anything
+  bool is_linearized() const noexcept {
+    return _head + _size <= capacity();
+  }
+
+  //Iterators
+  iterator begin() noexcept {
+    return iterator(this, 0);
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator cbegin() const noexcept {
+    return begin();
+  }
+
+  iterator end() noexcept {
+    return iterator(this, _size);
+  }
+
+  const_iterator end() const noexcept {
+    return const_iterator(this, _size);
+  }
+
+  const_iterator cend() const noexcept {
+    return end();
+  }
+
+  reverse_iterator rbegin() noexcept {
+    return reverse_iterator(end());
+  }
+
+  const_reverse_iterator rbegin() const noexcept {
+    return const_reverse_iterator(end());
+  }
+
+  reverse_iterator rend() noexcept {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rend() const noexcept {
+    return const_reverse_iterator(begin());
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return !_size;
+  }
+
+  bool full() const noexcept {
+    return _size == capacity();
+  }
+
+  size_type size() const noexcept {
+    return _size;
+  }
+
+  size_type capacity() const noexcept {
+    return _buffer.size();
+  }
+
+  size_type max_size() const noexcept {
+    return _buffer.max_size();
+  }
+
+  Overflow overflow() const noexcept {
+    return _overflow;
+  }
+
+  void reserve(size_type new_cap) {
+    if (new_cap > capacity())
+      expand(new_cap - capacity());
+  }
+
+  void shrink_to_fit() {
+    if (_overflow == Overflow::Grow && capacity() > _size) {
+      linearize();
+      _buffer.resize(_head + _size);
+      _buffer.erase(_buffer.begin(), _buffer.begin() + _head);
+      _buffer.shrink_to_fit();
+      _head = 0;
+    }
+  }
+
+  //Modifiers. Elements leaving the ring are replaced by T(), which frees what they hold.
+  void clear() {
+    for (size_type i = 0; i < _size; i++)
+      release(physical(i));
+    _head = 0;
+    _size = 0;
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  void push_front(const T& value) {
+    emplace_front(value);
+  }
+
+  void push_front(T&& value) {
+    emplace_front(std::move(value));
+  }
+
+  //In a full bounded ring the front element is overwritten and becomes the back
+  template<class... Args>
+  reference emplace_back(Args&&... args) {
+    //Built first, args may name the front slot overwritten below or an element grow() moves
+    T value(std::forward<Args>(args)...);
+    if (full()) {
+      if (_overflow == Overflow::OverwriteOldest) {
+        T& slot = _buffer[_head];
+        slot = std::move(value);
+        _head = wrap(_head + 1);
+        return slot;
+      }
+      grow();
+    }
+    T& slot = _buffer[physical(_size)];
+    slot = std::move(value);
+    _size++;
+    return slot;
+  }
+
+  //In a full bounded ring the back element is overwritten and becomes the front
+  template<class... Args>
+  reference emplace_front(Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    if (full()) {
+      if (_overflow == Overflow::OverwriteOldest) {
+        _head = _head ? _head - 1 : capacity() - 1;
+        T& slot = _buffer[_head];
+        slot = std::move(value);
+        return slot;
+      }
+      grow();
+    }
+    size_type head = _head ? _head - 1 : capacity() - 1;
+    _buffer[head] = std::move(value);
+    _head = head;
+    _size++;
+    return _buffer[_head];
+  }
+
+  void pop_back() {
+    release(physical(_size - 1));
+    _size--;
+  }
+
+  void pop_front() {
+    release(_head);
+    _head = wrap(_head + 1);
+    _size--;
+  }
+
+  void swap(CircularVector& other) noexcept {
+    _buffer.swap(other._buffer);
+    std::swap(_head, other._head);
+    std::swap(_size, other._size);
+    std::swap(_overflow, other._overflow);
+  }
+
+  //Hands the elements over in order as a Vector without copying them. A bounded ring
+  //keeps its capacity, a growing one is left empty.
+  Vector<T, Allocator> take() {
+    size_type cap = capacity();
+    linearize();
+    _buffer.resize(_head + _size);
+    _buffer.erase(_buffer.begin(), _buffer.begin() + _head);
+    Vector<T, Allocator> result(std::move(_buffer));
+    _head = 0;
+    _size = 0;
+    if (_overflow == Overflow::OverwriteOldest)
+      _buffer.resize(cap);
+    return result;
+  }
+
+private:
+  size_type wrap(size_type index) const noexcept {
+    return index >= capacity() ? index - capacity() : index;
+  }
+
+  size_type physical(size_type pos) const noexcept {
+    return wrap(_head + pos);
+  }
+
+  void release(size_type index) {
+    if constexpr (!std::is_trivially_destructible<T>::value)
+      _buffer[index] = T();
+  }
+
+  void grow() {
+    if (_size == max_size())
+      throw std::length_error("New capacity over limit");
+    expand(std::max<size_type>(_size, 1));
+  }
+
+  //Inserts count free slots right behind the last element. When the ring wraps, the
+  //elements from head on move up with the buffer's tail.
+  void expand(size_type count) {
+    size_type end = _head + _size;
+    if (end <= capacity()) {
+      _buffer.insert(_buffer.begin() + end, count, T());
+    }
+    else {
+      _buffer.insert(_buffer.begin() + (end - capacity()), count, T());
+      _head += count;
+    }
+  }
+
+  Vector<T, Allocator> _buffer;
+  size_type _head;
+  size_type _size;
+  Overflow _overflow;
+};
@@ -0,0 +1,381 @@
+#pragma once
+#include "vector.h"
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//Integer sequence stored in blocks of block_size values. Every full block is
+//bit-packed either as offsets from the block minimum (frame of reference) or as
+//offsets from the smallest delta between neighbours, whichever needs fewer bits.
+//The block index keeps each block's word offset, so any block decodes on its own.
+//Values that don't fill a block yet stay uncompressed in a tail buffer. Whole blocks
+//unpack through straight-line code generated for each bit width, with constant shifts
+//and masks the compiler can unroll and vectorize; there is no hand-written SIMD.
+template<class Int>
+class CompressedVector {
+  static_assert(std::is_integral<Int>::value && sizeof(Int) <= 8, "CompressedVector needs an integer type up to 64 bits");
+
+public:
+  using value_type = Int;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  static constexpr size_type block_size = 128;
+
+  class const_iterator;
+
+  CompressedVector() : _size(0) {
+    _tail.reserve(block_size);
+  }
+
+  explicit CompressedVector(const Vector<Int>& source) : CompressedVector() {
+    append(source.data(), source.size());
+  }
+
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  CompressedVector(InputIt first, InputIt last) : CompressedVector() {
+    for (; first != last; ++first)
+      push_back(*first);
+  }
+
+  void push_back(Int value) {
+    _tail.push_back(value);
+    _size++;
+    if (_tail.size() == block_size) {
+      encode_block(_tail.data());
+      _tail.clear();
+    }
+  }
+
+  //Bulk append, full blocks are encoded straight from the source
+  void append(const Int* values, size_type count) {
+    size_type i = 0;
+    while (i < count && !_tail.empty())
+      push_back(values[i++]);
+    for (; i + block_size <= count; i += block_size) {
+      encode_block(values + i);
+      _size += block_size;
+    }
+    for (; i < count; i++)
+      push_back(values[i]);
+  }
+
+  //Element access. Frame of reference blocks read one value, delta blocks sum the offsets
+  //up to pos, so scan with the iterators or decode_block(). Reads change no state, const
+  //access can be shared between threads.
+  Int operator[](size_type pos) const {
+    size_type block = pos / block_size;
+    size_type index = pos % block_size;
+    if (block == _blocks.size())
+      return _tail[index];
+
+    const BlockHeader& header = _blocks[block];
+    const std::uint64_t* words = _words.data() + header.offset;
+    if (header.encoding == Encoding::FrameOfReference)
+      return static_cast<Int>(header.base + extract(words, header.bits, index));
+
+    std::uint64_t value = header.base + index * header.reference;
+    for (size_type i = 1; i <= index; i++)
+      value += extract(words, header.bits, i);
+    return static_cast<Int>(value);
+  }
+
+  Int at(size_type pos) const {
+    if (pos >= _size)
+      throw std::out_of_range("CompressedVector subscript out of range");
+    return operator[](pos);
+  }
+
+  Int front() const {
+    return operator[](0);
+  }
+
+  Int back() const {
+    return operator[](_size - 1);
+  }
+
+  //Writes the block_size values of a full block or the tail values of the last one to out
+  void decode_block(size_type block, Int* out) const {
+    if (block == _blocks.size()) {
+      for (size_type i = 0; i < _tail.size(); i++)
+        out[i] = _tail[i];
+      return;
+    }
+
+    const BlockHeader& header = _blocks[block];
+    std::uint64_t raw[block_size];
+    unpack(_words.data() + header.offset, header.bits, raw);
+    if (header.encoding == Encoding::FrameOfReference) {
+      for (size_type i = 0; i < block_size; i++)
+        out[i] = static_cast<Int>(header.base + raw[i]);
+    }
+    else {
+      std::uint64_t value = header.base;
+      out[0] = static_cast<Int>(value);
+      for (size_type i = 1; i < block_size; i++) {
+        value += header.reference + raw[i];
+        out[i] = static_cast<Int>(value);
+      }
+    }
+  }
+
+  Vector<Int> to_vector() const {
+    Vector<Int> result(_size);
+    for (size_type block = 0; block * block_size < _size; block++)
+      decode_block(block, result.data() + block * block_size);
+    return result;
+  }
+
+  //Iterators
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, _size);
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return !(_size);
+  }
+
+  size_type size() const noexcept {
+    return _size;
+  }
+
+  size_type block_count() const noexcept {
+    return (_size + block_size - 1) / block_size;
+  }
+
+  //Bytes held by packed words, the block index and the tail buffer
+  size_type compressed_bytes() const noexcept {
+    return _words.size() * sizeof(std::uint64_t)
+      + _blocks.size() * sizeof(BlockHeader)
+      + _tail.size() * sizeof(Int);
+  }
+
+  void clear() noexcept {
+    _words.clear();
+    _blocks.clear();
+    _tail.clear();
+    _size = 0;
+  }
+
+  //Decodes a block at a time into a buffer of its own, so iterators don't share state.
+  //A copy starts without the decoded block and decodes it on its first read.
+  class const_iterator {
+  public:
+    using value_type = Int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Int*;
+    using reference = Int;
+    using iterator_category = std::input_iterator_tag;
+
+    const_iterator() : _owner(nullptr), _pos(0), _block(no_block) {}
+    const_iterator(const CompressedVector* owner, size_type pos) : _owner(owner), _pos(pos), _block(no_block) {}
+
+    const_iterator(const const_iterator& other) : _owner(other._owner), _pos(other._pos), _block(no_block) {}
+
+    const_iterator& operator=(const const_iterator& other) {
+      _owner = other._owner;
+      _pos = other._pos;
+      _block = no_block;
+      return *this;
+    }
+
+    Int operator*() const {
+      size_type block = _pos / block_size;
+      if (block != _block) {
+        if (!_buffer)
+          _buffer.reset(new Int[block_size]);
+        _owner->decode_block(block, _buffer.get());
+        _block = block;
+      }
+      return _buffer[_pos % block_size];
+    }
+
+    const_iterator& operator++() {
+      _pos++;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator it(*this);
+      _pos++;
+      return it;
+    }
+
+    friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+      return lhs._pos == rhs._pos;
+    }
+
+    friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+      return lhs._pos != rhs._pos;
+    }
+
+  private:
+    const CompressedVector* _owner;
+    size_type _pos;
+    mutable size_type _block;
+    mutable std::unique_ptr<Int[]> _buffer;
+  };
+
+private:
+  enum class Encoding : std::uint8_t {
+    FrameOfReference,
+    Delta
+  };
+
+  struct BlockHeader {
+    size_type offset;
+    std::uint64_t base;
+    std::uint64_t reference;
+    std::uint8_t bits;
+    Encoding encoding;
+  };
+
+  static constexpr size_type no_block = static_cast<size_type>(-1);
+
+  static std::uint8_t bit_width(std::uint64_t value) {
+    std::uint8_t bits = 0;
+    for (; value; value >>= 1)
+      bits++;
+    return bits;
+  }
+
+  static constexpr std::uint64_t mask(unsigned bits) {
+    return bits == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+  }
+
+  static std::uint64_t extract(const std::uint64_t* words, std::uint8_t bits, size_type index) {
+    if (!bits)
+      return 0;
+    size_type bit = index * bits;
+    size_type word = bit / 64;
+    size_type shift = bit % 64;
+    std::uint64_t value = words[word] >> shift;
+    if (shift + bits > 64)
+      value |= words[word + 1] << (64 - shift);
+    return value & mask(bits);
+  }
+
+  //64 values of Bits bits fill exactly Bits words, so a block is two identical groups
+  //and every shift below is a constant
+  template<unsigned Bits, size_type I>
+  static void unpack_value(const std::uint64_t* words, std::uint64_t* out) {
+    constexpr size_type word = I * Bits / 64;
+    constexpr size_type shift = I * Bits % 64;
+    std::uint64_t value = words[word] >> shift;
+    if constexpr (shift + Bits > 64)
+      value |= words[word + 1] << (64 - shift);
+    out[I] = value & mask(Bits);
+  }
+
+  template<unsigned Bits, size_type... I>
+  static void unpack_group(const std::uint64_t* words, std::uint64_t* out, std::index_sequence<I...>) {
+    (unpack_value<Bits, I>(words, out), ...);
+  }
+
+  template<unsigned Bits>
+  static void unpack_width(const std::uint64_t* words, std::uint64_t* out) {
+    if constexpr (Bits == 0) {
+      for (size_type i = 0; i < block_size; i++)
+        out[i] = 0;
+    }
+    else {
+      for (size_type group = 0; group < block_size / 64; group++)
+        unpack_group<Bits>(words + group * Bits, out + group * 64, std::make_index_sequence<64>());
+    }
+  }
+
+  using Unpacker = void (*)(const std::uint64_t*, std::uint64_t*);
+
+  template<unsigned... Bits>
+  static const Unpacker* unpackers(std::integer_sequence<unsigned, Bits...>) {
+    static constexpr Unpacker table[] = { &unpack_width<Bits>... };
+    return table;
+  }
+
+  static void unpack(const std::uint64_t* words, std::uint8_t bits, std::uint64_t* out) {
+    unpackers(std::make_integer_sequence<unsigned, 65>())[bits](words, out);
+  }
+
+  //A block of block_size values packs into exactly 2 * bits words
+  void pack(const std::uint64_t* values, std::uint8_t bits) {
+    size_type offset = _words.size();
+    _words.insert(_words.end(), 2 * bits, 0);
+    std::uint64_t* words = _words.data() + offset;
+    for (size_type i = 0; i < block_size && bits; i++) {
+      size_type bit = i * bits;
+      size_type word = bit / 64;
+      size_type shift = bit % 64;
+      words[word] |= values[i] << shift;
+      if (shift + bits > 64)
+        words[word + 1] |= values[i] >> (64 - shift);
+    }
+  }
+
+  void encode_block(const Int* values) {
+    std::uint64_t raw[block_size];
+    for (size_type i = 0; i < block_size; i++)
+      raw[i] = static_cast<std::uint64_t>(static_cast<std::int64_t>(values[i]));
+
+    //Frame of reference: offsets from the minimum
+    Int min = values[0];
+    Int max = values[0];
+    for (size_type i = 1; i < block_size; i++) {
+      if (values[i] < min)
+        min = values[i];
+      if (values[i] > max)
+        max = values[i];
+    }
+    std::uint64_t base = static_cast<std::uint64_t>(static_cast<std::int64_t>(min));
+    std::uint8_t for_bits = bit_width(static_cast<std::uint64_t>(static_cast<std::int64_t>(max)) - base);
+
+    //Delta: offsets from the smallest difference between neighbours
+    std::uint64_t deltas[block_size];
+    deltas[0] = 0;
+    std::int64_t min_delta = static_cast<std::int64_t>(raw[1] - raw[0]);
+    for (size_type i = 1; i < block_size; i++) {
+      std::int64_t delta = static_cast<std::int64_t>(raw[i] - raw[i - 1]);
+      if (delta < min_delta)
+        min_delta = delta;
+    }
+    std::uint64_t max_offset = 0;
+    for (size_type i = 1; i < block_size; i++) {
+      deltas[i] = raw[i] - raw[i - 1] - static_cast<std::uint64_t>(min_delta);
+      if (deltas[i] > max_offset)
+        max_offset = deltas[i];
+    }
+    std::uint8_t delta_bits = bit_width(max_offset);
+
+    BlockHeader header;
+    header.offset = _words.size();
+    if (delta_bits < for_bits) {
+      header.base = raw[0];
+      header.reference = static_cast<std::uint64_t>(min_delta);
+      header.bits = delta_bits;
+      header.encoding = Encoding::Delta;
+      pack(deltas, delta_bits);
+    }
+    else {
+      for (size_type i = 0; i < block_size; i++)
+        raw[i] -= base;
+      header.base = base;
+      header.reference = 0;
+      header.bits = for_bits;
+      header.encoding = Encoding::FrameOfReference;
+      pack(raw, for_bits);
+    }
+    _blocks.push_back(header);
+  }
+
+  Vector<std::uint64_t> _words;
+  Vector<BlockHeader> _blocks;
+  Vector<Int> _tail;
+  size_type _size;
+};
@@ -0,0 +1,338 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+//Heap algorithms over a flat array where node i has children D * i + 1 .. D * i + D.
+//With four or eight children a level holds a few cache lines worth of siblings, so a
+//sift down touches a quarter or an eighth of the levels a binary heap does and scans
+//each sibling group sequentially. placed(pos) is called whenever a value lands at pos.
+namespace dary_heap {
+
+template<std::size_t D, class T, class Less, class Placed>
+void sift_up(T* data, std::size_t pos, Less& less, Placed&& placed) {
+  T value = std::move(data[pos]);
+  while (pos) {
+    std::size_t parent = (pos - 1) / D;
+    if (!less(data[parent], value))
+      break;
+    data[pos] = std::move(data[parent]);
+    placed(pos);
+    pos = parent;
+  }
+  data[pos] = std::move(value);
+  placed(pos);
+}
+
+template<std::size_t D, class T, class Less, class Placed>
+void sift_down(T* data, std::size_t size, std::size_t pos, Less& less, Placed&& placed) {
+  T value = std::move(data[pos]);
+  for (;;) {
+    std::size_t first = D * pos + 1;
+    if (first >= size)
+      break;
+    std::size_t last = std::min(first + D, size);
+    std::size_t best = first;
+    for (std::size_t child = first + 1; child < last; child++)
+      if (less(data[best], data[child]))
+        best = child;
+    if (!less(value, data[best]))
+      break;
+    data[pos] = std::move(data[best]);
+    placed(pos);
+    pos = best;
+  }
+  data[pos] = std::move(value);
+  placed(pos);
+}
+
+//Floyd's bottom-up construction, O(size)
+template<std::size_t D, class T, class Less, class Placed>
+void make_heap(T* data, std::size_t size, Less& less, Placed&& placed) {
+  if (size < 2) {
+    if (size)
+      placed(0);
+    return;
+  }
+  for (std::size_t pos = size; pos-- > 0;) {
+    if (D * pos + 1 < size)
+      sift_down<D>(data, size, pos, less, placed);
+    else
+      placed(pos);
+  }
+}
+
+struct NotPlaced {
+  void operator()(std::size_t) const noexcept {}
+};
+
+}
+
+//Priority queue over a Vector with D children per node. Like std::priority_queue, top()
+//is the greatest value under Compare, so std::greater gives a min-heap for timers.
+template<class T, std::size_t D = 4, class Compare = std::less<T>>
+class DaryHeap {
+  static_assert(D >= 2, "DaryHeap needs at least two children per node");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using value_compare = Compare;
+
+  DaryHeap() = default;
+
+  explicit DaryHeap(const Compare& compare) : _compare(compare) {}
+
+  //Takes over values and orders them in O(n)
+  explicit DaryHeap(Vector<T> values, const Compare& compare = Compare())
+    : _values(std::move(values)), _compare(compare) {
+    dary_heap::make_heap<D>(_values.data(), _values.size(), _compare, dary_heap::NotPlaced());
+  }
+
+  //Replaces the contents with values, O(n)
+  void heapify(Vector<T> values) {
+    _values = std::move(values);
+    dary_heap::make_heap<D>(_values.data(), _values.size(), _compare, dary_heap::NotPlaced());
+  }
+
+  //Element access, the heap must not be empty
+  const T& top() const noexcept {
+    return _values[0];
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return _values.empty();
+  }
+
+  size_type size() const noexcept {
+    return _values.size();
+  }
+
+  size_type capacity() const noexcept {
+    return _values.capacity();
+  }
+
+  void reserve(size_type count) {
+    _values.reserve(count);
+  }
+
+  //Modifiers
+  void push(const T& value) {
+    emplace(value);
+  }
+
+  void push(T&& value) {
+    emplace(std::move(value));
+  }
+
+  template<class... Args>
+  void emplace(Args&&... args) {
+    _values.emplace_back(std::forward<Args>(args)...);
+    dary_heap::sift_up<D>(_values.data(), _values.size() - 1, _compare, dary_heap::NotPlaced());
+  }
+
+  //Removes top(), the heap must not be empty
+  void pop() {
+    if (_values.size() > 1) {
+      _values[0] = std::move(_values.back());
+      _values.pop_back();
+      dary_heap::sift_down<D>(_values.data(), _values.size(), 0, _compare, dary_heap::NotPlaced());
+    }
+    else {
+      _values.pop_back();
+    }
+  }
+
+  //Moves top() out and removes it
+  T take_top() {
+    T value = std::move(_values[0]);
+    pop();
+    return value;
+  }
+
+  void clear() noexcept {
+    _values.clear();
+  }
+
+  //Hands the values over in heap order and leaves the heap empty
+  Vector<T> release() noexcept {
+    return std::move(_values);
+  }
+
+  //The values in heap order
+  const Vector<T>& values() const noexcept {
+    return _values;
+  }
+
+private:
+  Vector<T> _values;
+  [[no_unique_address]] Compare _compare;
+};
+
+//DaryHeap of values keyed by small integer ids, with a table from id to heap position so
+//a queued value can be changed or removed in O(log n). decrease_key moves a value toward
+//the top, which for a std::greater timer queue means an earlier deadline.
+template<class T, std::size_t D = 4, class Compare = std::less<T>>
+class IndexedDaryHeap {
+  static_assert(D >= 2, "IndexedDaryHeap needs at least two children per node");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using id_type = std::uint32_t;
+  using value_compare = Compare;
+
+  IndexedDaryHeap() = default;
+
+  explicit IndexedDaryHeap(const Compare& compare) : _less{ compare } {}
+
+  //Queues (id, values[id]) for every id in O(n), replacing the contents
+  void heapify(const Vector<T>& values) {
+    if (values.size() > size_type(no_position))
+      throw std::length_error("IndexedDaryHeap over id limit");
+    _entries.clear();
+    _entries.reserve(values.size());
+    _positions.assign(values.size(), no_position);
+    for (size_type id = 0; id < values.size(); id++)
+      _entries.push_back(Entry{ values[id], static_cast<id_type>(id) });
+    dary_heap::make_heap<D>(_entries.data(), _entries.size(), _less, placed());
+  }
+
+  //Element access, the heap must not be empty
+  const T& top() const noexcept {
+    return _entries[0].value;
+  }
+
+  id_type top_id() const noexcept {
+    return _entries[0].id;
+  }
+
+  bool contains(id_type id) const noexcept {
+    return id < _positions.size() && _positions[id] != no_position;
+  }
+
+  //Queued value of id
+  const T& at(id_type id) const {
+    if (!contains(id))
+      throw std::out_of_range("IndexedDaryHeap id not queued");
+    return _entries[_positions[id]].value;
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return _entries.empty();
+  }
+
+  size_type size() const noexcept {
+    return _entries.size();
+  }
+
+  //Ids are expected below count
+  void reserve(size_type count) {
+    _entries.reserve(count);
+    if (count > _positions.size())
+      _positions.resize(count, no_position);
+  }
+
+  //Modifiers
+  //Queues value under id, which must not be queued already
+  void push(id_type id, T value) {
+    if (id == no_position)
+      throw std::length_error("IndexedDaryHeap over id limit");
+    if (contains(id))
+      throw std::invalid_argument("IndexedDaryHeap id already queued");
+    if (id >= _positions.size())
+      _positions.resize(std::max<size_type>(size_type(id) + 1, 2 * _positions.size()), no_position);
+    _entries.push_back(Entry{ std::move(value), id });
+    dary_heap::sift_up<D>(_entries.data(), _entries.size() - 1, _less, placed());
+  }
+
+  //Removes top(), the heap must not be empty
+  void pop() {
+    remove_at(0);
+  }
+
+  //Moves the queued value of id toward the top; value must not compare below the old one
+  void decrease_key(id_type id, T value) {
+    const T& old = at(id);
+    if (_less.compare(value, old))
+      throw std::invalid_argument("IndexedDaryHeap decrease_key moves away from the top");
+    size_type pos = _positions[id];
+    _entries[pos].value = std::move(value);
+    dary_heap::sift_up<D>(_entries.data(), pos, _less, placed());
+  }
+
+  //Replaces the queued value of id, moving it either way
+  void update(id_type id, T value) {
+    const T& old = at(id);
+    size_type pos = _positions[id];
+    bool up = _less.compare(old, value);
+    _entries[pos].value = std::move(value);
+    if (up)
+      dary_heap::sift_up<D>(_entries.data(), pos, _less, placed());
+    else
+      dary_heap::sift_down<D>(_entries.data(), _entries.size(), pos, _less, placed());
+  }
+
+  //False if id is not queued
+  bool erase(id_type id) {
+    if (!contains(id))
+      return false;
+    remove_at(_positions[id]);
+    return true;
+  }
+
+  void clear() noexcept {
+    for (const Entry& entry : _entries)
+      _positions[entry.id] = no_position;
+    _entries.clear();
+  }
+
+private:
+  struct Entry {
+    T value;
+    id_type id;
+  };
+
+  struct EntryLess {
+    bool operator()(const Entry& lhs, const Entry& rhs) const {
+      return compare(lhs.value, rhs.value);
+    }
+
+    [[no_unique_address]] Compare compare;
+  };
+
+  static constexpr id_type no_position = std::numeric_limits<id_type>::max();
+
+  auto placed() noexcept {
+    return [this](size_type pos) {
+      _positions[_entries[pos].id] = static_cast<id_type>(pos);
+    };
+  }
+
+  void remove_at(size_type pos) {
+    _positions[_entries[pos].id] = no_position;
+    size_type last = _entries.size() - 1;
+    if (pos == last) {
+      _entries.pop_back();
+      return;
+    }
+    bool up = _less(_entries[pos], _entries[last]);
+    _entries[pos] = std::move(_entries[last]);
+    _entries.pop_back();
+    if (up)
+      dary_heap::sift_up<D>(_entries.data(), pos, _less, placed());
+    else
+      dary_heap::sift_down<D>(_entries.data(), _entries.size(), pos, _less, placed());
+  }
+
+  Vector<Entry> _entries;
+  Vector<id_type> _positions;
+  EntryLess _less;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "vector.h"
+#include <atomic>
+#include <cstddef>
+
+//Single producer / single consumer handoff of whole Vector batches. The producer
+//appends into the back slot and publishes it, the consumer takes the oldest published
+//slot and hands it back once done. Slots are cleared, not freed, so after warm-up
+//batches move between threads without copies, allocations or locks.
+template<class T, std::size_t Slots = 2>
+class DoubleBufferedVector {
+  static_assert(Slots >= 2, "DoubleBufferedVector needs at least two slots");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  DoubleBufferedVector() : _head(0), _tail(0) {}
+
+  explicit DoubleBufferedVector(size_type capacity) : DoubleBufferedVector() {
+    for (auto& slot : _slots)
+      slot.reserve(capacity);
+  }
+
+  DoubleBufferedVector(const DoubleBufferedVector&) = delete;
+  DoubleBufferedVector& operator=(const DoubleBufferedVector&) = delete;
+
+  //Producer side
+
+  //False while every slot is published and waiting for the consumer
+  bool writable() const noexcept {
+    return _tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_acquire) < Slots;
+  }
+
+  //Slot the producer fills. Only valid while writable().
+  Vector<T>& back() noexcept {
+    return _slots[_tail.load(std::memory_order_relaxed) % Slots];
+  }
+
+  bool publish() noexcept {
+    if (!writable())
+      return false;
+    _tail.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  //Consumer side
+
+  size_type published() const noexcept {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_relaxed);
+  }
+
+  //Oldest published batch, nullptr if none. Stays owned by the consumer until release().
+  Vector<T>* acquire() noexcept {
+    if (!published())
+      return nullptr;
+    return &_slots[_head.load(std::memory_order_relaxed) % Slots];
+  }
+
+  //Clears the acquired batch, keeping its capacity, and returns it to the producer
+  void release() noexcept {
+    _slots[_head.load(std::memory_order_relaxed) % Slots].clear();
+    _head.fetch_add(1, std::memory_order_release);
+  }
+
+  //Swaps the oldest published batch into out. The old buffer of out goes back
+  //to the producer, cleared but with its capacity.
+  bool take(Vector<T>& out) noexcept {
+    Vector<T>* batch = acquire();
+    if (!batch)
+      return false;
+    out.clear();
+    batch->swap(out);
+    _head.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  Vector<T> _slots[Slots];
+  alignas(64) std::atomic<size_type> _head;
+  alignas(64) std::atomic<size_type> _tail;
+};
@@ -0,0 +1,227 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//Sequence stored in a Vector with a run of spare slots, the gap, at the edit point.
+//Inserting or erasing at the gap only moves the gap ends, so edits clustered around
+//a cursor cost O(1) amortized. Moving the gap elsewhere moves the elements in between,
+//O(distance). Gap slots hold value-initialized T, so T must be default constructible.
+//release() moves the gap to the end and hands the storage over as a Vector.
+template<class T, class Allocator = std::allocator<T>>
+class GapBuffer {
+  static_assert(std::is_default_constructible<T>::value, "GapBuffer needs a default constructible type");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = IndexIterator<GapBuffer, T>;
+  using const_iterator = IndexIterator<const GapBuffer, const T>;
+
+  static constexpr size_type min_gap = 64;
+
+  GapBuffer() : _gap_begin(0), _gap_end(0) {}
+
+  //Adopts the elements of vector without copying, the cursor at the end
+  explicit GapBuffer(Vector<T, Allocator> vector)
+    : _buffer(std::move(vector)), _gap_begin(_buffer.size()), _gap_end(_buffer.size()) {}
+
+  GapBuffer(std::initializer_list<T> init) : GapBuffer(Vector<T, Allocator>(init)) {}
+
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  GapBuffer(InputIt first, InputIt last) : GapBuffer(Vector<T, Allocator>(first, last)) {}
+
+  //Element access
+  reference operator[](size_type pos) noexcept {
+    return _buffer[physical(pos)];
+  }
+
+  const_reference operator[](size_type pos) const noexcept {
+    return _buffer[physical(pos)];
+  }
+
+  reference at(size_type pos) {
+    if (pos >= size())
+      throw std::out_of_range("GapBuffer subscript out of range");
+    return (*this)[pos];
+  }
+
+  const_reference at(size_type pos) const {
+    if (pos >= size())
+      throw std::out_of_range("GapBuffer subscript out of range");
+    return (*this)[pos];
+  }
+
+  //Iterators
+  iterator begin() noexcept {
+    return iterator(this, 0);
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(this, 0);
+  }
+
+  iterator end() noexcept {
+    return iterator(this, size());
+  }
+
+  const_iterator end() const noexcept {
+    return const_iterator(this, size());
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return !size();
+  }
+
+  size_type size() const noexcept {
+    return _buffer.size() - gap();
+  }
+
+  size_type capacity() const noexcept {
+    return _buffer.size();
+  }
+
+  size_type gap() const noexcept {
+    return _gap_end - _gap_begin;
+  }
+
+  //Makes room for count more elements at the cursor
+  void reserve_gap(size_type count) {
+    if (gap() >= count)
+      return;
+    size_type grow_by = std::max({ count - gap(), _buffer.size(), min_gap });
+    _buffer.insert(_buffer.begin() + _gap_end, grow_by, T());
+    _gap_end += grow_by;
+  }
+
+  //Cursor
+  size_type cursor() const noexcept {
+    return _gap_begin;
+  }
+
+  //Moves the gap so the next edit at pos is free, O(|pos - cursor()|)
+  void move_cursor(size_type pos) {
+    if (pos > size())
+      throw std::out_of_range("GapBuffer cursor out of range");
+    if (!gap()) {
+      //Nothing to move, and moving elements onto themselves would empty some types
+      _gap_begin = pos;
+      _gap_end = pos;
+    }
+    else if (pos < _gap_begin) {
+      std::move_backward(_buffer.begin() + pos, _buffer.begin() + _gap_begin, _buffer.begin() + _gap_end);
+      _gap_end -= _gap_begin - pos;
+      _gap_begin = pos;
+    }
+    else if (pos > _gap_begin) {
+      size_type count = pos - _gap_begin;
+      std::move(_buffer.begin() + _gap_end, _buffer.begin() + _gap_end + count, _buffer.begin() + _gap_begin);
+      _gap_begin += count;
+      _gap_end += count;
+    }
+  }
+
+  //Modifiers. Every edit moves the cursor to its position first.
+  iterator insert(size_type pos, const T& value) {
+    return emplace(pos, value);
+  }
+
+  iterator insert(size_type pos, T&& value) {
+    return emplace(pos, std::move(value));
+  }
+
+  iterator insert(size_type pos, size_type count, const T& value) {
+    T copy(value);
+    move_cursor(pos);
+    reserve_gap(count);
+    std::fill_n(_buffer.begin() + _gap_begin, count, copy);
+    _gap_begin += count;
+    return iterator(this, pos);
+  }
+
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  iterator insert(size_type pos, InputIt first, InputIt last) {
+    move_cursor(pos);
+    if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>::value)
+      reserve_gap(static_cast<size_type>(std::distance(first, last)));
+    for (; first != last; ++first) {
+      reserve_gap(1);
+      _buffer[_gap_begin++] = *first;
+    }
+    return iterator(this, pos);
+  }
+
+  template<class... Args>
+  iterator emplace(size_type pos, Args&&... args) {
+    T value(std::forward<Args>(args)...);
+    move_cursor(pos);
+    reserve_gap(1);
+    _buffer[_gap_begin++] = std::move(value);
+    return iterator(this, pos);
+  }
+
+  void push_back(const T& value) {
+    insert(size(), value);
+  }
+
+  void push_back(T&& value) {
+    insert(size(), std::move(value));
+  }
+
+  //Erases [pos, pos + count), which joins the gap
+  iterator erase(size_type pos, size_type count = 1) {
+    if (pos + count > size())
+      throw std::out_of_range("GapBuffer erase out of range");
+    move_cursor(pos);
+    if constexpr (!std::is_trivially_destructible<T>::value)
+      std::fill_n(_buffer.begin() + _gap_end, count, T());
+    _gap_end += count;
+    return iterator(this, pos);
+  }
+
+  //Erases count elements before the cursor, as backspace does
+  void erase_before_cursor(size_type count = 1) {
+    if (count > _gap_begin)
+      throw std::out_of_range("GapBuffer erase out of range");
+    erase(_gap_begin - count, count);
+  }
+
+  void clear() {
+    _buffer.clear();
+    _gap_begin = 0;
+    _gap_end = 0;
+  }
+
+  //Elements in one contiguous run. Moves the gap to the end, O(size() - cursor()).
+  std::span<T> contiguous() {
+    move_cursor(size());
+    return std::span<T>(_buffer.data(), _gap_begin);
+  }
+
+  //Hands the elements over as a Vector without copying them and leaves the buffer empty
+  Vector<T, Allocator> release() {
+    move_cursor(size());
+    _buffer.resize(_gap_begin);
+    Vector<T, Allocator> result(std::move(_buffer));
+    clear();
+    return result;
+  }
+
+private:
+  size_type physical(size_type pos) const noexcept {
+    return pos < _gap_begin ? pos : pos + gap();
+  }
+
+  Vector<T, Allocator> _buffer;
+  size_type _gap_begin;
+  size_type _gap_end;
+};
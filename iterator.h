@@ -1,129 +1,232 @@
 #pragma once
+#include <compare>
+#include <cstddef>
 #include <iterator>
+#include <memory>
+#include <type_traits>
 
-template<class T>
-class Iterator;
-
-template<class T>
-struct std::iterator_traits<Iterator<T>> {
-  using difference_type = std::ptrdiff_t;
-  using value_type = T;
-  using reference = T&;
-  using pointer = T*;
-  using iterator_category = std::random_access_iterator_tag;
-};
-
+//Contiguous iterator over T. Iterator<const T> is the const iterator and
+//converts from Iterator<T>. std::to_address unwraps both to the raw pointer,
+//so standard algorithms take their pointer (memmove, vectorized) paths.
 template<class T>
 class Iterator {
 public:
-  using value_type = T;
+  using value_type = std::remove_cv_t<T>;
   using difference_type = std::ptrdiff_t;
   using pointer = T*;
   using reference = T&;
   using iterator_category = std::random_access_iterator_tag;
-  using size_type = std::size_t;
+  using iterator_concept = std::contiguous_iterator_tag;
+  using element_type = T;
 
-  Iterator(T* ptr) : _ptr(ptr) {}
-  Iterator(const Iterator& other) : _ptr(other._ptr) {}
-  Iterator(const Iterator&& other) : _ptr(std::move(other._ptr)) {}
-  ~Iterator() {}
+  Iterator() noexcept : _ptr(nullptr) {}
+  Iterator(T* ptr) noexcept : _ptr(ptr) {}
 
-  Iterator& operator=(const Iterator& other) {
-    _ptr = other._ptr;
-    return *this;
-  }
+  template<class U, class = std::enable_if_t<!std::is_same_v<U, T> && std::is_convertible_v<U*, T*>>>
+  Iterator(const Iterator<U>& other) noexcept : _ptr(other.operator->()) {}
 
-  Iterator& operator=(Iterator&& other) {
-    _ptr = std::move(_ptr, other._ptr);
-  }
-
-  Iterator& operator++() {
+  Iterator& operator++() noexcept {
     _ptr++;
     return *this;
   }
 
-  Iterator& operator++(int) {
+  Iterator operator++(int) noexcept {
     Iterator it(_ptr);
     _ptr++;
     return it;
   }
 
-  Iterator& operator+=(size_type count) {
+  Iterator& operator+=(difference_type count) noexcept {
     _ptr += count;
     return *this;
   }
 
-  Iterator& operator--() {
+  Iterator& operator--() noexcept {
     _ptr--;
     return *this;
   }
 
-  Iterator& operator--(int) {
+  Iterator operator--(int) noexcept {
     Iterator it(_ptr);
     _ptr--;
     return it;
   }
 
-  Iterator& operator-=(size_type count) {
+  Iterator& operator-=(difference_type count) noexcept {
     _ptr -= count;
     return *this;
   }
 
-  friend Iterator operator+(const Iterator& other, size_type count) {
+  friend Iterator operator+(const Iterator& other, difference_type count) noexcept {
     return Iterator(other._ptr + count);
   }
 
-  friend Iterator operator+(size_type count, const Iterator& other) {
+  friend Iterator operator+(difference_type count, const Iterator& other) noexcept {
     return Iterator(other._ptr + count);
   }
 
-  friend Iterator operator-(const Iterator& other, size_type count) {
+  friend Iterator operator-(const Iterator& other, difference_type count) noexcept {
     return Iterator(other._ptr - count);
   }
 
-  friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+  friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr - rhs._ptr;
   }
 
-  reference operator*() const {
+  reference operator*() const noexcept {
     return *_ptr;
   }
 
-  pointer operator->() const {
+  pointer operator->() const noexcept {
     return _ptr;
   }
 
-  reference operator[](size_type pos) const {
+  reference operator[](difference_type pos) const noexcept {
     return *(_ptr + pos);
   }
 
-  friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+  friend bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr == rhs._ptr;
   }
 
-  friend bool operator!=(const Iterator& rhs, const Iterator& lhs) {
+  friend bool operator!=(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr != rhs._ptr;
   }
 
-  friend bool operator<(const Iterator& lhs, const Iterator& rhs) {
+  friend bool operator<(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr < rhs._ptr;
   }
 
-  friend bool operator>(const Iterator& lhs, const Iterator& rhs) {
+  friend bool operator>(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr > rhs._ptr;
   }
 
-  friend bool operator<=(const Iterator& lhs, const Iterator& rhs) {
+  friend bool operator<=(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr <= rhs._ptr;
   }
 
-  friend bool operator>=(const Iterator& lhs, const Iterator& rhs) {
+  friend bool operator>=(const Iterator& lhs, const Iterator& rhs) noexcept {
     return lhs._ptr >= rhs._ptr;
   }
 
-  friend void swap(Iterator& lhs, Iterator& rhs) {
+  friend void swap(Iterator& lhs, Iterator& rhs) noexcept {
     std::swap(lhs._ptr, rhs._ptr);
   }
 private:
   pointer _ptr;
-};
\ No newline at end of file
+};
+
+template<class T>
+struct std::pointer_traits<Iterator<T>> {
+  using pointer = Iterator<T>;
+  using element_type = T;
+  using difference_type = std::ptrdiff_t;
+
+  template<class U>
+  using rebind = Iterator<U>;
+
+  static T* to_address(const Iterator<T>& it) noexcept {
+    return it.operator->();
+  }
+};
+
+//Random access iterator for containers that index in O(1) without being contiguous,
+//such as CircularVector and GapBuffer. It holds the container and a logical index
+//and maps the index to an element through Owner::operator[]. Owner and T are const
+//for the const iterator, which converts from the mutable one.
+template<class Owner, class T>
+class IndexIterator {
+public:
+  using value_type = std::remove_cv_t<T>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T*;
+  using reference = T&;
+  using iterator_category = std::random_access_iterator_tag;
+
+  IndexIterator() noexcept : _owner(nullptr), _index(0) {}
+  IndexIterator(Owner* owner, std::size_t index) noexcept : _owner(owner), _index(index) {}
+
+  template<class OtherOwner, class U, class = std::enable_if_t<!std::is_same_v<OtherOwner, Owner>
+    && std::is_convertible_v<OtherOwner*, Owner*> && std::is_convertible_v<U*, T*>>>
+  IndexIterator(const IndexIterator<OtherOwner, U>& other) noexcept : _owner(other._owner), _index(other._index) {}
+
+  reference operator*() const noexcept {
+    return (*_owner)[_index];
+  }
+
+  pointer operator->() const noexcept {
+    return &(*_owner)[_index];
+  }
+
+  reference operator[](difference_type n) const noexcept {
+    return (*_owner)[_index + n];
+  }
+
+  //Logical position in the container
+  std::size_t index() const noexcept {
+    return _index;
+  }
+
+  IndexIterator& operator++() noexcept {
+    _index++;
+    return *this;
+  }
+
+  IndexIterator operator++(int) noexcept {
+    IndexIterator it(*this);
+    _index++;
+    return it;
+  }
+
+  IndexIterator& operator--() noexcept {
+    _index--;
+    return *this;
+  }
+
+  IndexIterator operator--(int) noexcept {
+    IndexIterator it(*this);
+    _index--;
+    return it;
+  }
+
+  IndexIterator& operator+=(difference_type n) noexcept {
+    _index += n;
+    return *this;
+  }
+
+  IndexIterator& operator-=(difference_type n) noexcept {
+    _index -= n;
+    return *this;
+  }
+
+  friend IndexIterator operator+(IndexIterator it, difference_type n) noexcept {
+    return it += n;
+  }
+
+  friend IndexIterator operator+(difference_type n, IndexIterator it) noexcept {
+    return it += n;
+  }
+
+  friend IndexIterator operator-(IndexIterator it, difference_type n) noexcept {
+    return it -= n;
+  }
+
+  friend difference_type operator-(const IndexIterator& lhs, const IndexIterator& rhs) noexcept {
+    return static_cast<difference_type>(lhs._index) - static_cast<difference_type>(rhs._index);
+  }
+
+  friend bool operator==(const IndexIterator& lhs, const IndexIterator& rhs) noexcept {
+    return lhs._index == rhs._index;
+  }
+
+  friend auto operator<=>(const IndexIterator& lhs, const IndexIterator& rhs) noexcept {
+    return lhs._index <=> rhs._index;
+  }
+
+private:
+  template<class, class>
+  friend class IndexIterator;
+
+  Owner* _owner;
+  std::size_t _index;
+};
@@ -0,0 +1,364 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+//Accounting is compiled in with VECTOR_MEMORY_REGISTRY=1, defined the same way in every
+//translation unit. Without it Account is empty and Vectors carry no registry state.
+#if !defined(VECTOR_MEMORY_REGISTRY)
+#define VECTOR_MEMORY_REGISTRY 0
+#endif
+
+//Opt-in accounting of Vector heap use per element type and user tag. Once enable()d,
+//every Vector reports its buffer whenever its size or capacity changes: live
+//instances, bytes in use (size), slack (capacity - size) and the peak of allocated bytes.
+//Entries sit in a fixed table claimed with compare-and-swap and the counters are
+//atomics, so reporting is lock-free. Snapshots are formatted without allocating,
+//which lets a signal handler write one from a running process.
+namespace memory_registry {
+
+constexpr std::size_t kMaxEntries = 256;
+constexpr std::size_t kNameLength = 128;
+
+struct Entry {
+  std::atomic<std::uint64_t> key{0};
+  std::atomic<bool> ready{false};
+  char type[kNameLength];
+  char tag[kNameLength];
+  std::atomic<std::int64_t> instances{0};
+  std::atomic<std::int64_t> used_bytes{0};
+  std::atomic<std::int64_t> allocated_bytes{0};
+  std::atomic<std::int64_t> peak_bytes{0};
+};
+
+inline std::atomic<bool>& enabled_flag() {
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+
+inline void enable(bool on = true) {
+  enabled_flag().store(on, std::memory_order_relaxed);
+}
+
+inline bool enabled() {
+  return enabled_flag().load(std::memory_order_relaxed);
+}
+
+inline Entry* entries() {
+  static Entry table[kMaxEntries];
+  return table;
+}
+
+inline std::uint64_t hash_name(const char* type, const char* tag) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (; *type; type++)
+    hash = (hash ^ static_cast<unsigned char>(*type)) * 1099511628211ull;
+  hash = (hash ^ 0xff) * 1099511628211ull;
+  for (; tag && *tag; tag++)
+    hash = (hash ^ static_cast<unsigned char>(*tag)) * 1099511628211ull;
+  return hash ? hash : 1;
+}
+
+//Entry for a type and tag, nullptr once the table is full
+inline Entry* find_entry(const char* type, const char* tag) {
+  std::uint64_t key = hash_name(type, tag);
+  Entry* table = entries();
+  for (std::size_t probe = 0; probe < kMaxEntries; probe++) {
+    Entry& entry = table[(key + probe) % kMaxEntries];
+    std::uint64_t current = entry.key.load(std::memory_order_acquire);
+    if (!current && entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      std::snprintf(entry.type, kNameLength, "%s", type);
+      std::snprintf(entry.tag, kNameLength, "%s", tag ? tag : "");
+      entry.ready.store(true, std::memory_order_release);
+      return &entry;
+    }
+    if (current == key)
+      return &entry;
+  }
+  return nullptr;
+}
+
+//Readable name of T taken from the compiler's function signature, so no RTTI is needed
+template<class T>
+const char* type_name() noexcept {
+  struct Name {
+    explicit Name(const char* signature) noexcept {
+      const char* first = std::strstr(signature, "T = ");
+      const char* last = nullptr;
+      if (first) {
+        first += 4;
+        last = first + std::strcspn(first, ";]");
+      }
+      else if ((first = std::strstr(signature, "type_name<"))) {
+        first += 10;
+        last = std::strrchr(first, '>');
+      }
+      if (!first || !last) {
+        first = signature;
+        last = signature + std::strlen(signature);
+      }
+      std::size_t length = static_cast<std::size_t>(last - first);
+      if (length >= kNameLength)
+        length = kNameLength - 1;
+      std::memcpy(text, first, length);
+      text[length] = '\0';
+    }
+
+    char text[kNameLength];
+  };
+#if defined(_MSC_VER)
+  static const Name name(__FUNCSIG__);
+#else
+  static const Name name(__PRETTY_FUNCTION__);
+#endif
+  return name.text;
+}
+
+#if VECTOR_MEMORY_REGISTRY
+//What one Vector has reported, so each report only adds the difference
+class Account {
+public:
+  Account() noexcept : _entry(nullptr), _tag(nullptr), _used(0), _allocated(0) {}
+  Account(const Account&) = delete;
+  Account& operator=(const Account&) = delete;
+
+  template<class T>
+  void update(std::size_t size, std::size_t capacity) noexcept {
+    if (!_entry) {
+      if (!capacity || !enabled())
+        return;
+      _entry = find_entry(type_name<T>(), _tag);
+      if (!_entry)
+        return;
+      _entry->instances.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::int64_t used = static_cast<std::int64_t>(size * sizeof(T));
+    std::int64_t allocated = static_cast<std::int64_t>(capacity * sizeof(T));
+    _entry->used_bytes.fetch_add(used - _used, std::memory_order_relaxed);
+    std::int64_t total = _entry->allocated_bytes.fetch_add(allocated - _allocated, std::memory_order_relaxed)
+      + allocated - _allocated;
+    std::int64_t peak = _entry->peak_bytes.load(std::memory_order_relaxed);
+    while (total > peak && !_entry->peak_bytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {}
+    _used = used;
+    _allocated = allocated;
+  }
+
+  //Withdraws everything this Vector reported
+  void release() noexcept {
+    if (!_entry)
+      return;
+    _entry->used_bytes.fetch_sub(_used, std::memory_order_relaxed);
+    _entry->allocated_bytes.fetch_sub(_allocated, std::memory_order_relaxed);
+    _entry->instances.fetch_sub(1, std::memory_order_relaxed);
+    _entry = nullptr;
+    _used = 0;
+    _allocated = 0;
+  }
+
+  //Tag to report under. Takes effect from the next report, the string must outlive the Vector.
+  template<class T>
+  void retag(const char* tag, std::size_t size, std::size_t capacity) noexcept {
+    release();
+    _tag = tag;
+    update<T>(size, capacity);
+  }
+
+  void swap(Account& other) noexcept {
+    std::swap(_entry, other._entry);
+    std::swap(_tag, other._tag);
+    std::swap(_used, other._used);
+    std::swap(_allocated, other._allocated);
+  }
+
+private:
+  Entry* _entry;
+  const char* _tag;
+  std::int64_t _used;
+  std::int64_t _allocated;
+};
+#else
+//Empty, Vector holds it as a no_unique_address member
+class Account {
+public:
+  template<class T>
+  void update(std::size_t, std::size_t) noexcept {}
+
+  void release() noexcept {}
+
+  template<class T>
+  void retag(const char*, std::size_t, std::size_t) noexcept {}
+
+  void swap(Account&) noexcept {}
+};
+#endif
+
+//Appends into a fixed buffer without allocating, usable from a signal handler
+class Writer {
+public:
+  Writer(char* buffer, std::size_t capacity) : _buffer(buffer), _capacity(capacity), _length(0) {
+    if (_capacity)
+      _buffer[0] = '\0';
+  }
+
+  Writer& text(const char* str) {
+    for (; *str; str++)
+      put(*str);
+    return *this;
+  }
+
+  Writer& quoted(const char* str) {
+    put('"');
+    for (; *str; str++) {
+      if (*str == '"' || *str == '\\')
+        put('\\');
+      put(*str);
+    }
+    put('"');
+    return *this;
+  }
+
+  Writer& number(std::int64_t value) {
+    if (value < 0) {
+      put('-');
+      value = -value;
+    }
+    char digits[24];
+    int count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value);
+    while (count)
+      put(digits[--count]);
+    return *this;
+  }
+
+  std::size_t length() const {
+    return _length;
+  }
+
+private:
+  void put(char c) {
+    if (_length + 1 < _capacity) {
+      _buffer[_length++] = c;
+      _buffer[_length] = '\0';
+    }
+  }
+
+  char* _buffer;
+  std::size_t _capacity;
+  std::size_t _length;
+};
+
+//One line per type and tag, returns the formatted length
+inline std::size_t format_text(char* buffer, std::size_t capacity) {
+  Writer out(buffer, capacity);
+  Entry* table = entries();
+  for (std::size_t i = 0; i < kMaxEntries; i++) {
+    Entry& entry = table[i];
+    if (!entry.ready.load(std::memory_order_acquire))
+      continue;
+    std::int64_t used = entry.used_bytes.load(std::memory_order_relaxed);
+    std::int64_t allocated = entry.allocated_bytes.load(std::memory_order_relaxed);
+    out.text(entry.type);
+    if (entry.tag[0])
+      out.text(" [").text(entry.tag).text("]");
+    out.text(" instances=").number(entry.instances.load(std::memory_order_relaxed))
+      .text(" used=").number(used)
+      .text(" slack=").number(allocated - used)
+      .text(" allocated=").number(allocated)
+      .text(" peak=").number(entry.peak_bytes.load(std::memory_order_relaxed))
+      .text("\n");
+  }
+  return out.length();
+}
+
+inline std::size_t format_json(char* buffer, std::size_t capacity) {
+  Writer out(buffer, capacity);
+  out.text("[");
+  bool first = true;
+  Entry* table = entries();
+  for (std::size_t i = 0; i < kMaxEntries; i++) {
+    Entry& entry = table[i];
+    if (!entry.ready.load(std::memory_order_acquire))
+      continue;
+    std::int64_t used = entry.used_bytes.load(std::memory_order_relaxed);
+    std::int64_t allocated = entry.allocated_bytes.load(std::memory_order_relaxed);
+    out.text(first ? "\n" : ",\n");
+    out.text("  {\"type\": ").quoted(entry.type)
+      .text(", \"tag\": ").quoted(entry.tag)
+      .text(", \"instances\": ").number(entry.instances.load(std::memory_order_relaxed))
+      .text(", \"used_bytes\": ").number(used)
+      .text(", \"slack_bytes\": ").number(allocated - used)
+      .text(", \"allocated_bytes\": ").number(allocated)
+      .text(", \"peak_bytes\": ").number(entry.peak_bytes.load(std::memory_order_relaxed))
+      .text("}");
+    first = false;
+  }
+  out.text("\n]\n");
+  return out.length();
+}
+
+constexpr std::size_t kSnapshotSize = kMaxEntries * 512;
+
+inline bool dump(std::FILE* file, bool json = false) {
+  static char buffer[kSnapshotSize];
+  std::size_t length = json ? format_json(buffer, sizeof(buffer)) : format_text(buffer, sizeof(buffer));
+  return std::fwrite(buffer, 1, length, file) == length;
+}
+
+#if !defined(_WIN32)
+inline char* snapshot_path() {
+  static char path[512];
+  return path;
+}
+
+inline void write_snapshot(int) {
+  static char buffer[kSnapshotSize];
+  std::size_t length = format_json(buffer, sizeof(buffer));
+  int fd = open(snapshot_path(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  for (std::size_t written = 0; written < length;) {
+    ssize_t count = write(fd, buffer + written, length - written);
+    if (count <= 0)
+      break;
+    written += static_cast<std::size_t>(count);
+  }
+  close(fd);
+}
+
+//Writes a JSON snapshot to path whenever signum arrives, e.g. SIGUSR1
+inline bool install_signal_snapshot(int signum, const char* path) {
+  std::snprintf(snapshot_path(), 512, "%s", path);
+  entries();
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = write_snapshot;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  return sigaction(signum, &action, nullptr) == 0;
+}
+#endif
+
+//Zeroes every counter. Only meaningful while no tracked Vector is alive.
+inline void reset() {
+  Entry* table = entries();
+  for (std::size_t i = 0; i < kMaxEntries; i++) {
+    table[i].instances.store(0);
+    table[i].used_bytes.store(0);
+    table[i].allocated_bytes.store(0);
+    table[i].peak_bytes.store(0);
+  }
+}
+
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+
+//Opt-in log of Vector operations for replaying real workloads, see vector_replay.cpp.
+//While started, every Vector appends one record per operation to a thread-local buffer:
+//the operation, the Vector's address as its id, position, count, and size and capacity
+//after the operation, all as LEB128 varints: about 14 bytes a record on disk against
+//sizeof(op_trace::Record), 48 bytes on 64-bit targets, once decoded. Buffers are
+//written to the trace file when full, when their thread exits and, for the calling
+//thread, in stop(). Stop after joining the threads that used Vectors.
+namespace op_trace {
+
+enum class Op : std::uint8_t {
+  Create,      //count = initial size, position = element size
+  Destroy,
+  PushBack,
+  PopBack,
+  Insert,      //count elements at position
+  Erase,       //count elements at position
+  Reserve,     //count = new capacity
+  Resize,      //count = new size
+  ShrinkToFit,
+  Clear,
+  Begin,       //begin() called, the start of an iteration or of a position
+  Swap,        //position = id of the other Vector
+  CopyFrom,    //position = id of the source Vector
+  MoveFrom,    //position = id of the source Vector
+};
+
+constexpr std::uint8_t kOpCount = static_cast<std::uint8_t>(Op::MoveFrom) + 1;
+constexpr char kMagic[4] = { 'V', 'T', 'R', '1' };
+constexpr std::size_t kBufferSize = std::size_t(64) << 10;
+constexpr std::size_t kMaxRecordSize = 1 + 6 * 10;
+
+struct Record {
+  Op op;
+  std::uint64_t id;
+  std::uint64_t position;
+  std::uint64_t count;
+  std::uint64_t size;
+  std::uint64_t capacity;
+};
+
+struct State {
+  std::atomic<bool> enabled{false};
+  std::atomic<std::uint64_t> generation{0};
+  std::mutex mutex;
+  std::FILE* file = nullptr;
+  std::uint64_t records = 0;
+};
+
+inline State& state() {
+  static State instance;
+  return instance;
+}
+
+inline bool enabled() noexcept {
+  return state().enabled.load(std::memory_order_relaxed);
+}
+
+inline std::size_t put_varint(unsigned char* out, std::uint64_t value) noexcept {
+  std::size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = static_cast<unsigned char>(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = static_cast<unsigned char>(value);
+  return length;
+}
+
+class Buffer {
+public:
+  Buffer() noexcept : _data(new (std::nothrow) unsigned char[kBufferSize]), _length(0), _records(0), _generation(0) {}
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  ~Buffer() {
+    flush();
+    destroyed() = true;
+  }
+
+  //Set once the thread's buffer is gone, for Vectors destroyed after it
+  static bool& destroyed() noexcept {
+    thread_local bool flag = false;
+    return flag;
+  }
+
+  void append(const Record& record) noexcept {
+    if (!_data)
+      return;
+    std::uint64_t generation = state().generation.load(std::memory_order_acquire);
+    if (generation != _generation) {
+      //Left over from an earlier trace
+      _length = 0;
+      _records = 0;
+      _generation = generation;
+    }
+    if (_length + kMaxRecordSize > kBufferSize)
+      flush();
+    unsigned char* out = _data.get() + _length;
+    std::size_t length = 0;
+    out[length++] = static_cast<unsigned char>(record.op);
+    length += put_varint(out + length, record.id);
+    length += put_varint(out + length, record.position);
+    length += put_varint(out + length, record.count);
+    length += put_varint(out + length, record.size);
+    length += put_varint(out + length, record.capacity);
+    _length += length;
+    _records++;
+  }
+
+  void flush() noexcept {
+    if (!_length)
+      return;
+    State& shared = state();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (shared.file && shared.generation.load(std::memory_order_relaxed) == _generation) {
+      std::fwrite(_data.get(), 1, _length, shared.file);
+      shared.records += _records;
+    }
+    _length = 0;
+    _records = 0;
+  }
+
+private:
+  std::unique_ptr<unsigned char[]> _data;
+  std::size_t _length;
+  std::uint64_t _records;
+  std::uint64_t _generation;
+};
+
+inline Buffer& local_buffer() {
+  thread_local Buffer buffer;
+  return buffer;
+}
+
+inline void record(const void* vector, Op op, std::uint64_t position, std::uint64_t count,
+    std::uint64_t size, std::uint64_t capacity) noexcept {
+  if (Buffer::destroyed())
+    return;
+  local_buffer().append(Record{ op, reinterpret_cast<std::uintptr_t>(vector), position, count, size, capacity });
+}
+
+//Starts tracing into path, truncating it. False if the file can't be opened.
+inline bool start(const char* path) {
+  State& shared = state();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  if (shared.file)
+    return false;
+  shared.file = std::fopen(path, "wb");
+  if (!shared.file)
+    return false;
+  std::fwrite(kMagic, 1, sizeof(kMagic), shared.file);
+  shared.records = 0;
+  shared.generation.fetch_add(1, std::memory_order_release);
+  shared.enabled.store(true, std::memory_order_release);
+  return true;
+}
+
+//Stops tracing and closes the file, returns the number of records written
+inline std::uint64_t stop() {
+  State& shared = state();
+  shared.enabled.store(false, std::memory_order_release);
+  local_buffer().flush();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  if (shared.file) {
+    std::fclose(shared.file);
+    shared.file = nullptr;
+  }
+  return shared.records;
+}
+
+//Reads a trace written by start() and stop()
+class Reader {
+public:
+  explicit Reader(const char* path)
+    : _file(std::fopen(path, "rb")), _data(new unsigned char[kBufferSize]), _length(0), _pos(0) {
+    char magic[sizeof(kMagic)];
+    if (_file && (std::fread(magic, 1, sizeof(magic), _file) != sizeof(magic) || std::memcmp(magic, kMagic, sizeof(magic)))) {
+      std::fclose(_file);
+      _file = nullptr;
+    }
+  }
+
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  ~Reader() {
+    if (_file)
+      std::fclose(_file);
+  }
+
+  //False when the file is missing or not a trace
+  bool valid() const noexcept {
+    return _file != nullptr;
+  }
+
+  //False at the end of the trace or at a truncated record
+  bool next(Record& record) {
+    int op = get();
+    if (op < 0 || op >= kOpCount)
+      return false;
+    record.op = static_cast<Op>(op);
+    return varint(record.id) && varint(record.position) && varint(record.count)
+      && varint(record.size) && varint(record.capacity);
+  }
+
+private:
+  int get() {
+    if (_pos == _length) {
+      if (!_file)
+        return -1;
+      _length = std::fread(_data.get(), 1, kBufferSize, _file);
+      _pos = 0;
+      if (!_length)
+        return -1;
+    }
+    return _data[_pos++];
+  }
+
+  bool varint(std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int byte = get();
+      if (byte < 0)
+        return false;
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  std::FILE* _file;
+  std::unique_ptr<unsigned char[]> _data;
+  std::size_t _length;
+  std::size_t _pos;
+};
+
+}
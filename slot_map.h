@@ -0,0 +1,213 @@
+#pragma once
+#include "vector.h"
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+//Values packed densely in a Vector, addressed through stable handles. A handle names a
+//slot and the slot's generation; the slot holds the value's current dense index. Erase
+//moves the last value into the hole and repoints its slot, so values stay contiguous
+//for iteration and both insert and erase are O(1). Freed slots are reused with a new
+//generation, so handles to erased values stop resolving instead of aliasing new ones.
+//Occupied slots have odd generations, free ones even.
+template<class T>
+class SlotMap {
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = typename Vector<T>::iterator;
+  using const_iterator = typename Vector<T>::const_iterator;
+
+  struct Handle {
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    friend bool operator==(const Handle& lhs, const Handle& rhs) noexcept {
+      return lhs.index == rhs.index && lhs.generation == rhs.generation;
+    }
+
+    friend bool operator!=(const Handle& lhs, const Handle& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+  };
+
+  //Never returned by insert
+  static constexpr Handle null_handle = { std::numeric_limits<std::uint32_t>::max(), 0 };
+
+  SlotMap() : _free_head(no_slot) {}
+
+  template<class... Args>
+  Handle emplace(Args&&... args) {
+    if (_values.size() >= max_size())
+      throw std::length_error("SlotMap over handle limit");
+    //Bookkeeping grows first and is rolled back if the value throws
+    std::uint32_t index = _free_head;
+    bool fresh = index == no_slot;
+    if (fresh) {
+      index = static_cast<std::uint32_t>(_slots.size());
+      _slots.push_back(Slot{ 0, 0 });
+    }
+    try {
+      _dense_to_slot.push_back(index);
+      _values.emplace_back(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      if (_dense_to_slot.size() > _values.size())
+        _dense_to_slot.pop_back();
+      if (fresh)
+        _slots.pop_back();
+      throw;
+    }
+
+    if (!fresh)
+      _free_head = _slots[index].index;
+    Slot& slot = _slots[index];
+    slot.index = static_cast<std::uint32_t>(_values.size() - 1);
+    slot.generation++;
+    return Handle{ index, slot.generation };
+  }
+
+  Handle insert(const T& value) {
+    return emplace(value);
+  }
+
+  Handle insert(T&& value) {
+    return emplace(std::move(value));
+  }
+
+  //False if the handle no longer resolves
+  bool erase(Handle handle) {
+    if (!contains(handle))
+      return false;
+    Slot& slot = _slots[handle.index];
+    std::uint32_t hole = slot.index;
+    std::uint32_t last = static_cast<std::uint32_t>(_values.size() - 1);
+    if (hole != last) {
+      _values[hole] = std::move(_values[last]);
+      _dense_to_slot[hole] = _dense_to_slot[last];
+      _slots[_dense_to_slot[hole]].index = hole;
+    }
+    _values.pop_back();
+    _dense_to_slot.pop_back();
+
+    slot.generation++;
+    slot.index = _free_head;
+    _free_head = handle.index;
+    return true;
+  }
+
+  bool contains(Handle handle) const noexcept {
+    return handle.index < _slots.size() && _slots[handle.index].generation == handle.generation
+      && (handle.generation & 1);
+  }
+
+  //nullptr if the handle no longer resolves
+  T* get(Handle handle) noexcept {
+    return contains(handle) ? &_values[_slots[handle.index].index] : nullptr;
+  }
+
+  const T* get(Handle handle) const noexcept {
+    return contains(handle) ? &_values[_slots[handle.index].index] : nullptr;
+  }
+
+  T& at(Handle handle) {
+    if (!contains(handle))
+      throw std::out_of_range("SlotMap handle does not resolve");
+    return _values[_slots[handle.index].index];
+  }
+
+  const T& at(Handle handle) const {
+    if (!contains(handle))
+      throw std::out_of_range("SlotMap handle does not resolve");
+    return _values[_slots[handle.index].index];
+  }
+
+  //Unchecked, the handle must resolve
+  T& operator[](Handle handle) noexcept {
+    return _values[_slots[handle.index].index];
+  }
+
+  const T& operator[](Handle handle) const noexcept {
+    return _values[_slots[handle.index].index];
+  }
+
+  //Handle of the value at a dense position, e.g. while iterating
+  Handle handle_at(size_type pos) const noexcept {
+    std::uint32_t index = _dense_to_slot[pos];
+    return Handle{ index, _slots[index].generation };
+  }
+
+  //Dense iteration. Erasing moves the last value, so iterate backwards to erase while iterating.
+  iterator begin() noexcept {
+    return _values.begin();
+  }
+
+  const_iterator begin() const noexcept {
+    return _values.begin();
+  }
+
+  iterator end() noexcept {
+    return _values.end();
+  }
+
+  const_iterator end() const noexcept {
+    return _values.end();
+  }
+
+  T* data() noexcept {
+    return _values.data();
+  }
+
+  const T* data() const noexcept {
+    return _values.data();
+  }
+
+  bool empty() const noexcept {
+    return _values.empty();
+  }
+
+  size_type size() const noexcept {
+    return _values.size();
+  }
+
+  size_type max_size() const noexcept {
+    return no_slot;
+  }
+
+  //Slots ever handed out, live or free
+  size_type slot_count() const noexcept {
+    return _slots.size();
+  }
+
+  void reserve(size_type count) {
+    _values.reserve(count);
+    _dense_to_slot.reserve(count);
+    _slots.reserve(count);
+  }
+
+  //Erases every value. Outstanding handles stop resolving.
+  void clear() {
+    for (std::uint32_t dense_index = 0; dense_index < _dense_to_slot.size(); dense_index++) {
+      std::uint32_t index = _dense_to_slot[dense_index];
+      _slots[index].generation++;
+      _slots[index].index = _free_head;
+      _free_head = index;
+    }
+    _values.clear();
+    _dense_to_slot.clear();
+  }
+
+private:
+  struct Slot {
+    std::uint32_t index;       //dense index while occupied, next free slot otherwise
+    std::uint32_t generation;
+  };
+
+  static constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+  Vector<T> _values;
+  Vector<std::uint32_t> _dense_to_slot;
+  Vector<Slot> _slots;
+  std::uint32_t _free_head;
+};
@@ -0,0 +1,386 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VECTOR_HAS_AVX2_GATHER 1
+#else
+#define VECTOR_HAS_AVX2_GATHER 0
+#endif
+
+//Vector of a fixed dimension that stores only its non-zero entries, as sorted indices
+//and their values in two parallel Vectors. Dot products against dense data touch only
+//the stored entries, with AVX2 gathers for float and double where available and four
+//independent accumulators otherwise. Sparse-sparse products intersect the index lists
+//four against four with AVX2 for float and double, finishing with a branchless scalar
+//merge, or binary search the longer one when the sizes differ a lot.
+template<class T, class Index = std::uint32_t>
+class SparseVector {
+  static_assert(std::is_arithmetic<T>::value, "SparseVector needs an arithmetic type");
+  static_assert(std::is_unsigned<Index>::value, "SparseVector indices must be unsigned");
+
+public:
+  using value_type = T;
+  using index_type = Index;
+  using size_type = std::size_t;
+
+  SparseVector() noexcept : _dimension(0) {}
+
+  explicit SparseVector(size_type dimension) : _dimension(dimension) {
+    if (dimension > size_type(std::numeric_limits<Index>::max()) + 1)
+      throw std::length_error("SparseVector dimension over index limit");
+  }
+
+  //Keeps the entries of dense that differ from zero
+  explicit SparseVector(const Vector<T>& dense) : SparseVector(dense.size()) {
+    const T* values = dense.data();
+    size_type count = 0;
+    for (size_type i = 0; i < dense.size(); i++)
+      count += values[i] != T(0);
+    reserve(count);
+    for (size_type i = 0; i < dense.size(); i++)
+      if (values[i] != T(0))
+        append(static_cast<Index>(i), values[i]);
+  }
+
+  Vector<T> to_dense() const {
+    Vector<T> dense(_dimension, T(0));
+    scatter_add(dense.data(), T(1));
+    return dense;
+  }
+
+  //Element access, O(log nnz)
+  T operator[](size_type pos) const noexcept {
+    auto it = std::lower_bound(_indices.begin(), _indices.end(), pos);
+    return it != _indices.end() && *it == pos ? _values[it - _indices.begin()] : T(0);
+  }
+
+  size_type dimension() const noexcept {
+    return _dimension;
+  }
+
+  //Stored entries
+  size_type nnz() const noexcept {
+    return _indices.size();
+  }
+
+  bool empty() const noexcept {
+    return _indices.empty();
+  }
+
+  const Vector<Index>& indices() const noexcept {
+    return _indices;
+  }
+
+  const Vector<T>& values() const noexcept {
+    return _values;
+  }
+
+  void reserve(size_type count) {
+    _indices.reserve(count);
+    _values.reserve(count);
+  }
+
+  void clear() noexcept {
+    _indices.clear();
+    _values.clear();
+  }
+
+  //Adds an entry behind the last one, O(1) amortized. Indices must increase.
+  void append(Index index, T value) {
+    if (index >= _dimension || (!_indices.empty() && index <= _indices.back()))
+      throw std::out_of_range("SparseVector append out of order");
+    _indices.push_back(index);
+    try {
+      _values.push_back(value);
+    }
+    catch (...) {
+      _indices.pop_back();
+      throw;
+    }
+  }
+
+  //Sets any entry, O(nnz) when it is new. Setting zero removes the entry.
+  void set(Index index, T value) {
+    if (index >= _dimension)
+      throw std::out_of_range("SparseVector subscript out of range");
+    auto it = std::lower_bound(_indices.begin(), _indices.end(), index);
+    size_type pos = it - _indices.begin();
+    if (it != _indices.end() && *it == index) {
+      if (value == T(0)) {
+        _indices.erase(_indices.begin() + pos);
+        _values.erase(_values.begin() + pos);
+      }
+      else {
+        _values[pos] = value;
+      }
+    }
+    else if (value != T(0)) {
+      _indices.insert(_indices.begin() + pos, index);
+      _values.insert(_values.begin() + pos, value);
+    }
+  }
+
+  //dense += scale * this
+  void scatter_add(T* dense, T scale) const noexcept {
+    const Index* idx = _indices.data();
+    const T* val = _values.data();
+    for (size_type i = 0; i < _indices.size(); i++)
+      dense[idx[i]] += scale * val[i];
+  }
+
+  void scatter_add(Vector<T>& dense, T scale = T(1)) const {
+    if (dense.size() != _dimension)
+      throw std::length_error("SparseVector operands differ in size");
+    scatter_add(dense.data(), scale);
+  }
+
+  //Sum of this[i] * dense[i] over the stored entries
+  T dot(const T* dense) const noexcept {
+    const Index* idx = _indices.data();
+    const T* val = _values.data();
+    size_type count = _indices.size();
+    size_type i = 0;
+    T sum(0);
+#if VECTOR_HAS_AVX2_GATHER
+    if constexpr (sizeof(Index) == 4 && (std::is_same<T, float>::value || std::is_same<T, double>::value)) {
+      if (_dimension <= size_type(std::numeric_limits<std::int32_t>::max()))
+        sum = gather_dot(idx, val, dense, count, i);
+    }
+#endif
+    T acc[4] = { T(0), T(0), T(0), T(0) };
+    for (; i + 4 <= count; i += 4) {
+      acc[0] += val[i] * dense[idx[i]];
+      acc[1] += val[i + 1] * dense[idx[i + 1]];
+      acc[2] += val[i + 2] * dense[idx[i + 2]];
+      acc[3] += val[i + 3] * dense[idx[i + 3]];
+    }
+    for (; i < count; i++)
+      acc[0] += val[i] * dense[idx[i]];
+    return sum + (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  }
+
+  T dot(const Vector<T>& dense) const {
+    if (dense.size() != _dimension)
+      throw std::length_error("SparseVector operands differ in size");
+    return dot(dense.data());
+  }
+
+  T dot(const SparseVector& other) const {
+    if (other._dimension != _dimension)
+      throw std::length_error("SparseVector operands differ in size");
+    const SparseVector& small = nnz() <= other.nnz() ? *this : other;
+    const SparseVector& large = nnz() <= other.nnz() ? other : *this;
+    const Index* a = small._indices.data();
+    const Index* b = large._indices.data();
+    size_type na = small.nnz();
+    size_type nb = large.nnz();
+    T sum(0);
+    if (na * kGallopRatio < nb) {
+      //Few entries against many: look each one up
+      const Index* from = b;
+      for (size_type i = 0; i < na; i++) {
+        from = std::lower_bound(from, b + nb, a[i]);
+        if (from == b + nb)
+          break;
+        if (*from == a[i])
+          sum += small._values[i] * large._values[from - b];
+      }
+      return sum;
+    }
+    size_type i = 0;
+    size_type j = 0;
+#if VECTOR_HAS_AVX2_GATHER
+    if constexpr (sizeof(Index) == 4 && (std::is_same<T, float>::value || std::is_same<T, double>::value))
+      sum = block_dot(a, small._values.data(), na, b, large._values.data(), nb, i, j);
+#endif
+    while (i < na && j < nb) {
+      Index x = a[i];
+      Index y = b[j];
+      sum += x == y ? small._values[i] * large._values[j] : T(0);
+      i += x <= y;
+      j += y <= x;
+    }
+    return sum;
+  }
+
+  //Element-wise sum. Entries that cancel to zero are dropped.
+  friend SparseVector operator+(const SparseVector& lhs, const SparseVector& rhs) {
+    if (lhs._dimension != rhs._dimension)
+      throw std::length_error("SparseVector operands differ in size");
+    SparseVector result(lhs._dimension);
+    result.reserve(lhs.nnz() + rhs.nnz());
+    size_type i = 0;
+    size_type j = 0;
+    while (i < lhs.nnz() || j < rhs.nnz()) {
+      Index x = i < lhs.nnz() ? lhs._indices[i] : std::numeric_limits<Index>::max();
+      Index y = j < rhs.nnz() ? rhs._indices[j] : std::numeric_limits<Index>::max();
+      T value(0);
+      Index index = std::min(x, y);
+      if (x == index && i < lhs.nnz())
+        value += lhs._values[i++];
+      if (y == index && j < rhs.nnz())
+        value += rhs._values[j++];
+      if (value != T(0))
+        result.push_unchecked(index, value);
+    }
+    return result;
+  }
+
+  //Sum of count sparse vectors of one dimension in a single pass over all entries
+  static SparseVector merge(const SparseVector* parts, size_type count) {
+    size_type dimension = count ? parts[0]._dimension : 0;
+    size_type total = 0;
+    for (size_type p = 0; p < count; p++) {
+      if (parts[p]._dimension != dimension)
+        throw std::length_error("SparseVector operands differ in size");
+      total += parts[p].nnz();
+    }
+    SparseVector result(dimension);
+    result.reserve(total);
+
+    //Min-heap of (index, part) over the next entry of every part
+    struct Cursor {
+      Index index;
+      size_type part;
+      size_type pos;
+    };
+    auto later = [](const Cursor& lhs, const Cursor& rhs) {
+      return lhs.index > rhs.index;
+    };
+    Vector<Cursor> heap;
+    heap.reserve(count);
+    for (size_type p = 0; p < count; p++)
+      if (!parts[p].empty())
+        heap.push_back(Cursor{ parts[p]._indices[0], p, 0 });
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    while (!heap.empty()) {
+      Index index = heap.front().index;
+      T value(0);
+      while (!heap.empty() && heap.front().index == index) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Cursor& cursor = heap.back();
+        const SparseVector& part = parts[cursor.part];
+        value += part._values[cursor.pos++];
+        if (cursor.pos < part.nnz()) {
+          cursor.index = part._indices[cursor.pos];
+          std::push_heap(heap.begin(), heap.end(), later);
+        }
+        else {
+          heap.pop_back();
+        }
+      }
+      if (value != T(0))
+        result.push_unchecked(index, value);
+    }
+    return result;
+  }
+
+  static SparseVector merge(const Vector<SparseVector>& parts) {
+    return merge(parts.data(), parts.size());
+  }
+
+  friend bool operator==(const SparseVector& lhs, const SparseVector& rhs) {
+    return lhs._dimension == rhs._dimension && lhs._indices == rhs._indices && lhs._values == rhs._values;
+  }
+
+private:
+  //Below one entry in kGallopRatio matching, binary search beats the merge
+  static constexpr size_type kGallopRatio = 32;
+
+  void push_unchecked(Index index, T value) {
+    _indices.push_back(index);
+    _values.push_back(value);
+  }
+
+#if VECTOR_HAS_AVX2_GATHER
+  //Gathers eight (float) or four (double) dense values per step, advances i past them
+  static T gather_dot(const Index* idx, const T* val, const T* dense, size_type count, size_type& i) noexcept {
+    if constexpr (std::is_same<T, float>::value) {
+      __m256 acc = _mm256_setzero_ps();
+      for (; i + 8 <= count; i += 8) {
+        __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+        __m256 gathered = _mm256_i32gather_ps(dense, offsets, 4);
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(val + i), gathered));
+      }
+      alignas(32) float lanes[8];
+      _mm256_store_ps(lanes, acc);
+      return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+    else {
+      __m256d acc = _mm256_setzero_pd();
+      for (; i + 4 <= count; i += 4) {
+        __m128i offsets = _mm_loadu_si128(reinterpret_cast<const __m128i*>(idx + i));
+        __m256d gathered = _mm256_i32gather_pd(dense, offsets, 8);
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(val + i), gathered));
+      }
+      alignas(32) double lanes[4];
+      _mm256_store_pd(lanes, acc);
+      return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+  }
+
+  //Block-wise intersection: four indices of a against all four rotations of four of b,
+  //the products of equal lanes masked in. The block with the smaller last index is done;
+  //both are when the last indices match. Advances i and j past the blocks consumed.
+  static T block_dot(const Index* a, const T* va, size_type na, const Index* b, const T* vb, size_type nb,
+      size_type& i, size_type& j) noexcept {
+    if constexpr (std::is_same<T, float>::value) {
+      __m128 acc = _mm_setzero_ps();
+      while (i + 4 <= na && j + 4 <= nb) {
+        __m128i ia = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i ib = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128 xa = _mm_loadu_ps(va + i);
+        __m128 xb = _mm_loadu_ps(vb + j);
+        for (int rotation = 0; rotation < 4; rotation++) {
+          __m128 match = _mm_castsi128_ps(_mm_cmpeq_epi32(ia, ib));
+          acc = _mm_add_ps(acc, _mm_and_ps(match, _mm_mul_ps(xa, xb)));
+          ib = _mm_shuffle_epi32(ib, _MM_SHUFFLE(0, 3, 2, 1));
+          xb = _mm_shuffle_ps(xb, xb, _MM_SHUFFLE(0, 3, 2, 1));
+        }
+        Index last_a = a[i + 3];
+        Index last_b = b[j + 3];
+        i += last_a <= last_b ? 4 : 0;
+        j += last_b <= last_a ? 4 : 0;
+      }
+      alignas(16) float lanes[4];
+      _mm_store_ps(lanes, acc);
+      return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    else {
+      __m256d acc = _mm256_setzero_pd();
+      while (i + 4 <= na && j + 4 <= nb) {
+        __m128i ia = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i ib = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m256d xa = _mm256_loadu_pd(va + i);
+        __m256d xb = _mm256_loadu_pd(vb + j);
+        for (int rotation = 0; rotation < 4; rotation++) {
+          __m256d match = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(ia, ib)));
+          acc = _mm256_add_pd(acc, _mm256_and_pd(match, _mm256_mul_pd(xa, xb)));
+          ib = _mm_shuffle_epi32(ib, _MM_SHUFFLE(0, 3, 2, 1));
+          xb = _mm256_permute4x64_pd(xb, _MM_SHUFFLE(0, 3, 2, 1));
+        }
+        Index last_a = a[i + 3];
+        Index last_b = b[j + 3];
+        i += last_a <= last_b ? 4 : 0;
+        j += last_b <= last_a ? 4 : 0;
+      }
+      alignas(32) double lanes[4];
+      _mm256_store_pd(lanes, acc);
+      return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+  }
+#endif
+
+  Vector<Index> _indices;
+  Vector<T> _values;
+  size_type _dimension;
+};
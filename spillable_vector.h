@@ -0,0 +1,339 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace spill {
+
+//Anonymous scratch file, removed from the directory as soon as it is created
+class TempFile {
+public:
+  explicit TempFile(const char* directory = nullptr) {
+#if defined(_WIN32)
+    _file = std::tmpfile();
+    if (!_file)
+      throw std::system_error(errno, std::generic_category(), "SpillableVector temp file");
+#else
+    if (!directory) {
+      directory = std::getenv("TMPDIR");
+      if (!directory || !*directory)
+        directory = "/tmp";
+    }
+    std::string path = std::string(directory) + "/vector-spill-XXXXXX";
+    _fd = mkstemp(path.data());
+    if (_fd < 0)
+      throw std::system_error(errno, std::generic_category(), "SpillableVector temp file");
+    unlink(path.c_str());
+#endif
+  }
+
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+
+  ~TempFile() {
+#if defined(_WIN32)
+    std::fclose(_file);
+#else
+    close(_fd);
+#endif
+  }
+
+  void write(const void* data, std::size_t bytes, std::uint64_t offset) {
+#if defined(_WIN32)
+    if (_fseeki64(_file, static_cast<long long>(offset), SEEK_SET) || std::fwrite(data, 1, bytes, _file) != bytes)
+      throw std::system_error(errno, std::generic_category(), "SpillableVector write");
+#else
+    const char* src = static_cast<const char*>(data);
+    while (bytes) {
+      ssize_t count = pwrite(_fd, src, bytes, static_cast<off_t>(offset));
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        throw std::system_error(errno, std::generic_category(), "SpillableVector write");
+      src += count;
+      bytes -= static_cast<std::size_t>(count);
+      offset += static_cast<std::uint64_t>(count);
+    }
+#endif
+  }
+
+  void read(void* data, std::size_t bytes, std::uint64_t offset) {
+#if defined(_WIN32)
+    if (_fseeki64(_file, static_cast<long long>(offset), SEEK_SET) || std::fread(data, 1, bytes, _file) != bytes)
+      throw std::system_error(errno, std::generic_category(), "SpillableVector read");
+#else
+    char* dst = static_cast<char*>(data);
+    while (bytes) {
+      ssize_t count = pread(_fd, dst, bytes, static_cast<off_t>(offset));
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count <= 0)
+        throw std::system_error(count ? errno : EIO, std::generic_category(), "SpillableVector read");
+      dst += count;
+      bytes -= static_cast<std::size_t>(count);
+      offset += static_cast<std::uint64_t>(count);
+    }
+#endif
+  }
+
+private:
+#if defined(_WIN32)
+  std::FILE* _file;
+#else
+  int _fd;
+#endif
+};
+
+}
+
+//Vector of trivially copyable T that holds at most budget bytes in memory. Elements are
+//grouped in fixed chunks; once more chunks are resident than the budget allows, the
+//least recently used one is written to a temp file in one write and its buffer reused
+//for the chunk being loaded. Appends and for_each_chunk() scans therefore move whole
+//chunks at disk bandwidth, while operator[] pages single chunks in on demand.
+//Only chunks changed through mutate(), set() or the modifiers are written back when
+//evicted; chunks that were only read are dropped.
+//
+//
+//operator[] and at() return copies. Any access to another chunk may evict the one a
+//reference points into, so the reference from mutate() dangles after the next access
+//to another element, read(), push_back() or for_each_chunk(), and the pointer
+//for_each_chunk() passes is only valid during that call. There are no iterators for
+//the same reason, so a range-for can't hold one across evictions; scan with
+//for_each_chunk(). Reads page chunks in and update the LRU state, so even const
+//access needs external synchronization when shared between threads.
+template<class T>
+class SpillableVector {
+  static_assert(std::is_trivially_copyable<T>::value, "SpillableVector needs a trivially copyable type");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  static constexpr size_type kDefaultChunkBytes = size_type(4) << 20;
+
+  explicit SpillableVector(size_type budget_bytes, size_type chunk_bytes = kDefaultChunkBytes,
+      const char* directory = nullptr)
+    : _chunk_size(std::max<size_type>(1, chunk_bytes / sizeof(T))),
+      _max_resident(std::max<size_type>(1, budget_bytes / (_chunk_size * sizeof(T)))),
+      _size(0), _resident(0), _clock(0), _spills(0), _loads(0), _directory(directory) {}
+
+  SpillableVector(const SpillableVector&) = delete;
+  SpillableVector& operator=(const SpillableVector&) = delete;
+
+  //Element access by value. Reads leave the chunk clean, so it is not written back when evicted.
+  T operator[](size_type pos) const {
+    return touch(pos / _chunk_size).data[pos % _chunk_size];
+  }
+
+  T at(size_type pos) const {
+    if (pos >= _size)
+      throw std::out_of_range("SpillableVector subscript out of range");
+    return (*this)[pos];
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return !_size;
+  }
+
+  size_type size() const noexcept {
+    return _size;
+  }
+
+  size_type chunk_size() const noexcept {
+    return _chunk_size;
+  }
+
+  size_type resident_chunks() const noexcept {
+    return _resident;
+  }
+
+  size_type resident_bytes() const noexcept {
+    return _resident * _chunk_size * sizeof(T);
+  }
+
+  //Chunk writes and reads so far
+  size_type spills() const noexcept {
+    return _spills;
+  }
+
+  size_type loads() const noexcept {
+    return _loads;
+  }
+
+  //Writable element, marks its chunk for write-back
+  T& mutate(size_type pos) {
+    Chunk& chunk = touch(pos / _chunk_size);
+    chunk.dirty = true;
+    return chunk.data[pos % _chunk_size];
+  }
+
+  //Modifiers
+  void set(size_type pos, const T& value) {
+    if (pos >= _size)
+      throw std::out_of_range("SpillableVector subscript out of range");
+    mutate(pos) = value;
+  }
+
+  void push_back(const T& value) {
+    if (_size % _chunk_size == 0)
+      add_chunk();
+    Chunk& chunk = touch(_size / _chunk_size);
+    chunk.data.push_back(value);
+    chunk.dirty = true;
+    _size++;
+  }
+
+  //Bulk append, copied chunk by chunk
+  void append(const T* values, size_type count) {
+    while (count) {
+      if (_size % _chunk_size == 0)
+        add_chunk();
+      Chunk& chunk = touch(_size / _chunk_size);
+      size_type n = std::min(count, _chunk_size - chunk.data.size());
+      chunk.data.insert(chunk.data.end(), values, values + n);
+      chunk.dirty = true;
+      _size += n;
+      values += n;
+      count -= n;
+    }
+  }
+
+  void pop_back() {
+    Chunk& chunk = touch((_size - 1) / _chunk_size);
+    chunk.data.pop_back();
+    chunk.dirty = true;
+    _size--;
+    if (chunk.data.empty()) {
+      _chunks.pop_back();
+      _resident--;
+    }
+  }
+
+  //Drops every element. The temp file is kept for reuse.
+  void clear() noexcept {
+    _chunks.clear();
+    _resident = 0;
+    _size = 0;
+  }
+
+  //Calls body(const T* data, count) for every chunk in order
+  template<class Body>
+  void for_each_chunk(Body body) const {
+    for (size_type c = 0; c < _chunks.size(); c++) {
+      const Chunk& chunk = touch(c);
+      body(chunk.data.data(), chunk.data.size());
+    }
+  }
+
+  //Copies [first, first + count) out, a chunk at a time
+  void read(size_type first, T* out, size_type count) const {
+    if (first + count > _size)
+      throw std::out_of_range("SpillableVector read out of range");
+    while (count) {
+      const Chunk& chunk = touch(first / _chunk_size);
+      size_type offset = first % _chunk_size;
+      size_type n = std::min(count, chunk.data.size() - offset);
+      std::memcpy(out, chunk.data.data() + offset, n * sizeof(T));
+      out += n;
+      first += n;
+      count -= n;
+    }
+  }
+
+private:
+  struct Chunk {
+    Vector<T> data;
+    size_type stored = 0;
+    std::uint64_t last_use = 0;
+    bool resident = true;
+    bool dirty = false;
+  };
+
+  void add_chunk() {
+    Vector<T> buffer = take_buffer();
+    _chunks.emplace_back();
+    Chunk& chunk = _chunks.back();
+    chunk.data.swap(buffer);
+    chunk.last_use = ++_clock;
+    _resident++;
+  }
+
+  //Makes chunk c resident and marks it most recently used
+  Chunk& touch(size_type c) const {
+    Chunk& chunk = _chunks[c];
+    chunk.last_use = ++_clock;
+    if (chunk.resident)
+      return chunk;
+    Vector<T> buffer = take_buffer();
+    buffer.resize(chunk.stored);
+    _file->read(buffer.data(), chunk.stored * sizeof(T), offset_of(c));
+    _loads++;
+    chunk.data.swap(buffer);
+    chunk.resident = true;
+    chunk.dirty = false;
+    _resident++;
+    return chunk;
+  }
+
+  //Empty buffer with room for a chunk, taken from the least recently used chunk when
+  //the budget is used up
+  Vector<T> take_buffer() const {
+    Vector<T> buffer;
+    if (_resident >= _max_resident) {
+      size_type victim = _chunks.size();
+      for (size_type c = 0; c < _chunks.size(); c++)
+        if (_chunks[c].resident && (victim == _chunks.size() || _chunks[c].last_use < _chunks[victim].last_use))
+          victim = c;
+      if (victim != _chunks.size()) {
+        Chunk& chunk = _chunks[victim];
+        if (chunk.dirty && !chunk.data.empty()) {
+          if (!_file)
+            _file.reset(new spill::TempFile(_directory));
+          _file->write(chunk.data.data(), chunk.data.size() * sizeof(T), offset_of(victim));
+          _spills++;
+        }
+        chunk.stored = chunk.data.size();
+        chunk.resident = false;
+        chunk.dirty = false;
+        buffer.swap(chunk.data);
+        buffer.clear();
+        _resident--;
+      }
+    }
+    buffer.reserve(_chunk_size);
+    return buffer;
+  }
+
+  std::uint64_t offset_of(size_type c) const noexcept {
+    return static_cast<std::uint64_t>(c) * _chunk_size * sizeof(T);
+  }
+
+  size_type _chunk_size;
+  size_type _max_resident;
+  size_type _size;
+  mutable size_type _resident;
+  mutable std::uint64_t _clock;
+  mutable size_type _spills;
+  mutable size_type _loads;
+  const char* _directory;
+  mutable Vector<Chunk> _chunks;
+  mutable std::unique_ptr<spill::TempFile> _file;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECTOR_HAS_STREAMING 1
+#else
+#define VECTOR_HAS_STREAMING 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+//Copies and fills bigger than the last level cache bypass it with non-temporal stores,
+//so a huge Vector copy doesn't evict the working set of every other thread.
+namespace streaming {
+
+constexpr std::size_t kDefaultThreshold = std::size_t(8) << 20;
+constexpr std::size_t kPrefetchDistance = 512;
+
+inline std::size_t last_level_cache_size() {
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+  long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (l3 > 0)
+    return static_cast<std::size_t>(l3);
+#endif
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+  long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (l2 > 0)
+    return static_cast<std::size_t>(l2);
+#endif
+  return kDefaultThreshold;
+}
+
+inline std::atomic<std::size_t>& threshold_storage() {
+  static std::atomic<std::size_t> threshold(last_level_cache_size());
+  return threshold;
+}
+
+//Size in bytes from which copies go through the streaming path
+inline std::size_t threshold() {
+  return threshold_storage().load(std::memory_order_relaxed);
+}
+
+inline void set_threshold(std::size_t bytes) {
+  threshold_storage().store(bytes, std::memory_order_relaxed);
+}
+
+inline bool enabled_for(std::size_t bytes) {
+  return VECTOR_HAS_STREAMING && bytes >= threshold();
+}
+
+inline void copy(void* dst, const void* src, std::size_t bytes) {
+#if VECTOR_HAS_STREAMING
+  auto* d = static_cast<char*>(dst);
+  auto* s = static_cast<const char*>(src);
+  std::size_t head = (16 - reinterpret_cast<std::uintptr_t>(d) % 16) % 16;
+  if (head > bytes)
+    head = bytes;
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  bytes -= head;
+
+  std::size_t blocks = bytes / 64;
+  for (std::size_t i = 0; i < blocks; i++, d += 64, s += 64) {
+    _mm_prefetch(s + kPrefetchDistance, _MM_HINT_NTA);
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+    __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+  }
+  _mm_sfence();
+  std::memcpy(d, s, bytes % 64);
+#else
+  std::memcpy(dst, src, bytes);
+#endif
+}
+
+//Fills count copies of value. Falls back to a plain loop when the element
+//size doesn't divide the 16-byte store or dst isn't aligned to it.
+template<class T>
+void fill(T* dst, std::size_t count, const T& value) {
+  static_assert(std::is_trivially_copyable<T>::value, "streaming::fill needs trivially copyable T");
+#if VECTOR_HAS_STREAMING
+  if (16 % sizeof(T) == 0 && reinterpret_cast<std::uintptr_t>(dst) % sizeof(T) == 0) {
+    while (count && reinterpret_cast<std::uintptr_t>(dst) % 16) {
+      std::memcpy(dst++, &value, sizeof(T));
+      count--;
+    }
+    alignas(16) unsigned char pattern[16];
+    for (std::size_t i = 0; i < 16; i += sizeof(T))
+      std::memcpy(pattern + i, &value, sizeof(T));
+    __m128i line = _mm_load_si128(reinterpret_cast<const __m128i*>(pattern));
+
+    constexpr std::size_t per_store = 16 / sizeof(T);
+    auto* d = reinterpret_cast<__m128i*>(dst);
+    std::size_t stores = count / per_store;
+    for (std::size_t i = 0; i < stores; i++)
+      _mm_stream_si128(d + i, line);
+    _mm_sfence();
+    dst += stores * per_store;
+    count -= stores * per_store;
+  }
+#endif
+  for (std::size_t i = 0; i < count; i++)
+    std::memcpy(dst + i, &value, sizeof(T));
+}
+
+}
@@ -0,0 +1,320 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+
+//Column of strings packed into one character Vector. Each element is an offset and a
+//length into it, 8 bytes with the default 32-bit Offset against 32 for a std::string,
+//and growing the column moves raw bytes instead of string objects. Elements are read
+//as std::string_view, valid until the next modification. Replaced and erased strings
+//leave their bytes behind until compact().
+template<class Offset = std::uint32_t>
+class StringColumn {
+  static_assert(std::is_unsigned<Offset>::value, "StringColumn offsets must be unsigned");
+
+public:
+  using value_type = std::string_view;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  struct Entry {
+    Offset offset;
+    Offset length;
+  };
+
+  class const_iterator;
+  using iterator = const_iterator;
+
+  StringColumn() = default;
+
+  StringColumn(std::initializer_list<std::string_view> init) {
+    assign(init.begin(), init.end());
+  }
+
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  StringColumn(InputIt first, InputIt last) {
+    assign(first, last);
+  }
+
+  //Bulk build. Forward ranges are measured first, so both Vectors allocate once.
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  void assign(InputIt first, InputIt last) {
+    clear();
+    append(first, last);
+  }
+
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  void append(InputIt first, InputIt last) {
+    if constexpr (std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>::value) {
+      size_type bytes = 0;
+      size_type count = 0;
+      for (InputIt it = first; it != last; ++it, ++count)
+        bytes += std::string_view(*it).size();
+      reserve(_entries.size() + count, _chars.size() + bytes);
+    }
+    for (; first != last; ++first)
+      push_back(std::string_view(*first));
+  }
+
+  //Element access
+  std::string_view operator[](size_type pos) const noexcept {
+    const Entry& entry = _entries[pos];
+    return std::string_view(_chars.data() + entry.offset, entry.length);
+  }
+
+  std::string_view at(size_type pos) const {
+    if (pos >= size())
+      throw std::out_of_range("StringColumn subscript out of range");
+    return (*this)[pos];
+  }
+
+  std::string_view front() const noexcept {
+    return (*this)[0];
+  }
+
+  std::string_view back() const noexcept {
+    return (*this)[size() - 1];
+  }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(_chars.data(), _entries.data());
+  }
+
+  const_iterator end() const noexcept {
+    return const_iterator(_chars.data(), _entries.data() + _entries.size());
+  }
+
+  //Capacity
+  bool empty() const noexcept {
+    return _entries.empty();
+  }
+
+  size_type size() const noexcept {
+    return _entries.size();
+  }
+
+  //Characters held, including those of replaced and erased strings
+  size_type char_size() const noexcept {
+    return _chars.size();
+  }
+
+  //Characters no element refers to any more
+  size_type garbage_bytes() const noexcept {
+    return _garbage;
+  }
+
+  //Heap bytes of both Vectors
+  size_type memory_bytes() const noexcept {
+    return _chars.capacity() + _entries.capacity() * sizeof(Entry);
+  }
+
+  void reserve(size_type count, size_type chars) {
+    _entries.reserve(count);
+    _chars.reserve(chars);
+  }
+
+  void shrink_to_fit() {
+    _entries.shrink_to_fit();
+    _chars.shrink_to_fit();
+  }
+
+  //Modifiers
+  void clear() noexcept {
+    _entries.clear();
+    _chars.clear();
+    _garbage = 0;
+  }
+
+  void push_back(std::string_view str) {
+    Entry entry = store(str);
+    try {
+      _entries.push_back(entry);
+    }
+    catch (...) {
+      _chars.resize(entry.offset);
+      throw;
+    }
+  }
+
+  void pop_back() noexcept {
+    const Entry& entry = _entries.back();
+    if (entry.offset + entry.length == _chars.size())
+      _chars.resize(entry.offset);
+    else
+      _garbage += entry.length;
+    _entries.pop_back();
+  }
+
+  //Overwrites in place when the new string isn't longer, appends otherwise
+  void set(size_type pos, std::string_view str) {
+    Entry& entry = _entries[pos];
+    if (str.size() <= entry.length) {
+      std::memmove(_chars.data() + entry.offset, str.data(), str.size());
+      _garbage += entry.length - str.size();
+      entry.length = static_cast<Offset>(str.size());
+      return;
+    }
+    Entry stored = store(str);
+    _garbage += _entries[pos].length;
+    _entries[pos] = stored;
+  }
+
+  void erase(size_type pos) {
+    erase(pos, pos + 1);
+  }
+
+  void erase(size_type first, size_type last) {
+    for (size_type i = first; i < last; i++)
+      _garbage += _entries[i].length;
+    _entries.erase(_entries.begin() + first, _entries.begin() + last);
+  }
+
+  //Rewrites the characters in element order, dropping garbage. Strings that
+  //are read one after another then sit next to each other.
+  void compact() {
+    Vector<char> chars;
+    chars.reserve(_chars.size() - _garbage);
+    for (Entry& entry : _entries) {
+      const char* src = _chars.data() + entry.offset;
+      entry.offset = static_cast<Offset>(chars.size());
+      chars.insert(chars.end(), src, src + entry.length);
+    }
+    _chars.swap(chars);
+    _garbage = 0;
+  }
+
+  //Sorts the 8-byte entries, the characters stay where they are.
+  //compact() afterwards restores sequential layout for scans.
+  template<class Compare = std::less<std::string_view>>
+  void sort(Compare compare = Compare()) {
+    const char* chars = _chars.data();
+    std::sort(_entries.begin(), _entries.end(), [chars, &compare](const Entry& lhs, const Entry& rhs) {
+      return compare(std::string_view(chars + lhs.offset, lhs.length), std::string_view(chars + rhs.offset, rhs.length));
+    });
+  }
+
+  const Vector<char>& chars() const noexcept {
+    return _chars;
+  }
+
+  const Vector<Entry>& entries() const noexcept {
+    return _entries;
+  }
+
+  class const_iterator {
+  public:
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::string_view;
+    using pointer = void;
+    //Elements are returned by value, so this is only an input iterator to older code
+    using iterator_category = std::input_iterator_tag;
+    using iterator_concept = std::random_access_iterator_tag;
+
+    const_iterator() noexcept : _chars(nullptr), _entry(nullptr) {}
+    const_iterator(const char* chars, const Entry* entry) noexcept : _chars(chars), _entry(entry) {}
+
+    std::string_view operator*() const noexcept {
+      return std::string_view(_chars + _entry->offset, _entry->length);
+    }
+
+    std::string_view operator[](difference_type n) const noexcept {
+      return *(*this + n);
+    }
+
+    const_iterator& operator++() noexcept {
+      _entry++;
+      return *this;
+    }
+
+    const_iterator operator++(int) noexcept {
+      const_iterator it(*this);
+      _entry++;
+      return it;
+    }
+
+    const_iterator& operator--() noexcept {
+      _entry--;
+      return *this;
+    }
+
+    const_iterator operator--(int) noexcept {
+      const_iterator it(*this);
+      _entry--;
+      return it;
+    }
+
+    const_iterator& operator+=(difference_type n) noexcept {
+      _entry += n;
+      return *this;
+    }
+
+    const_iterator& operator-=(difference_type n) noexcept {
+      _entry -= n;
+      return *this;
+    }
+
+    friend const_iterator operator+(const_iterator it, difference_type n) noexcept {
+      return it += n;
+    }
+
+    friend const_iterator operator+(difference_type n, const_iterator it) noexcept {
+      return it += n;
+    }
+
+    friend const_iterator operator-(const_iterator it, difference_type n) noexcept {
+      return it -= n;
+    }
+
+    friend difference_type operator-(const const_iterator& lhs, const const_iterator& rhs) noexcept {
+      return lhs._entry - rhs._entry;
+    }
+
+    friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) noexcept {
+      return lhs._entry == rhs._entry;
+    }
+
+    friend auto operator<=>(const const_iterator& lhs, const const_iterator& rhs) noexcept {
+      return lhs._entry <=> rhs._entry;
+    }
+
+  private:
+    const char* _chars;
+    const Entry* _entry;
+  };
+
+private:
+  //Appends the characters. str may point into the column itself, so when the buffer
+  //has to grow it is moved first and str repointed into the new one.
+  Entry store(std::string_view str) {
+    size_type offset = _chars.size();
+    if (str.size() > std::numeric_limits<Offset>::max() - offset)
+      throw std::length_error("StringColumn characters over offset limit");
+    std::less<const char*> before;
+    const char* base = _chars.data();
+    if (offset + str.size() > _chars.capacity() && !str.empty()
+        && !before(str.data(), base) && before(str.data(), base + offset)) {
+      size_type source = str.data() - base;
+      _chars.reserve(std::max(offset + str.size(), 2 * _chars.capacity()));
+      str = std::string_view(_chars.data() + source, str.size());
+    }
+    _chars.insert(_chars.end(), str.begin(), str.end());
+    return Entry{ static_cast<Offset>(offset), static_cast<Offset>(str.size()) };
+  }
+
+  Vector<char> _chars;
+  Vector<Entry> _entries;
+  size_type _garbage = 0;
+};
+
+template<class Offset>
+bool operator==(const StringColumn<Offset>& lhs, const StringColumn<Offset>& rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
@@ -1,9 +1,33 @@
 #define CATCH_CONFIG_MAIN
+#define VECTOR_CAPACITY_PROFILE 1
+#define VECTOR_MEMORY_REGISTRY 1
 #pragma warning(disable : 4996)  
 #include "catch.hpp"
 #include "vector.h"
+#include "compressed_vector.h"
+#include "vector_expr.h"
+#include "double_buffered_vector.h"
+#include "vm_allocator.h"
+#include "vector_builder.h"
+#include "vector_hash.h"
+#include "vector_view.h"
+#include "circular_vector.h"
+#include "gap_buffer.h"
+#include "string_column.h"
+#include "sparse_vector.h"
+#include "spillable_vector.h"
+#include "op_trace.h"
+#include "slot_map.h"
+#include "dary_heap.h"
+#include <thread>
+#include <ranges>
+#include <sstream>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 class NonCopy {
 public:
@@ -237,7 +261,7 @@ TEST_CASE("Insert with iterator pos") {
   std::vector<double> expec_vec = { 9.5, 78.88, 36.6, -3.14 };
   REQUIRE(vector.empty() == false);
   REQUIRE(vector.size() == size + 1);
-  REQUIRE(vector.capacity() == size + 1);
+  REQUIRE(vector.capacity() == 2 * size);
   for (size_t i = 0; i < vector.size(); i++)
     REQUIRE(vector[i] == expec_vec[i]);
 }
@@ -251,7 +275,7 @@ TEST_CASE("Insert with iterator pos and rhs") {
   std::vector<double> expec_vec = { 9.5, 78.88, 36.6, -3.14 };
   REQUIRE(vector.empty() == false);
   REQUIRE(vector.size() == size + 1);
-  REQUIRE(vector.capacity() == size + 1);
+  REQUIRE(vector.capacity() == 2 * size);
   for (size_t i = 0; i < vector.size(); i++)
     REQUIRE(vector[i] == expec_vec[i]);
 }
@@ -315,6 +339,131 @@ TEST_CASE("Emplace") {
     REQUIRE(vector[i] == expected_vector[i]);
 }
 
+TEST_CASE("Emplace at front") {
+  Vector<int> vector = { 4, 6, 8 };
+  vector.emplace(vector.begin(), 2);
+
+  std::vector<int> expected_vector = { 2, 4, 6, 8 };
+  REQUIRE(vector.size() == 4);
+  REQUIRE(vector.capacity() == 6);
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(vector[i] == expected_vector[i]);
+}
+
+TEST_CASE("Emplace with free capacity") {
+  Vector<std::string> vector = { "a", "c", "d" };
+  vector.reserve(8);
+  std::string* ptr = vector.data();
+  vector.emplace(vector.begin() + 1, "b");
+  vector.emplace(vector.end(), "e");
+
+  std::vector<std::string> expected_vector = { "a", "b", "c", "d", "e" };
+  REQUIRE(vector.size() == 5);
+  REQUIRE(vector.capacity() == 8);
+  REQUIRE(vector.data() == ptr);
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(vector[i] == expected_vector[i]);
+}
+
+TEST_CASE("Insert of an element of the same vector") {
+  Vector<int> vector = { 1, 2, 3 };
+  vector.reserve(8);
+  vector.insert(vector.begin(), vector.back());
+  vector.emplace(vector.begin() + 1, vector[3]);
+  REQUIRE((vector == Vector<int>{ 3, 3, 1, 2, 3 }));
+
+  Vector<std::string> names = { "a", "b" };
+  names.reserve(4);
+  names.insert(names.begin(), names[1]);
+  REQUIRE((names == Vector<std::string>{ "b", "a", "b" }));
+}
+
+struct ThrowsOnCopy {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  ThrowsOnCopy(int value) : value(value) { live++; }
+  ThrowsOnCopy(const ThrowsOnCopy& other) : value(other.value) {
+    if (copies_left >= 0 && !copies_left--)
+      throw std::runtime_error("copy");
+    live++;
+  }
+  ThrowsOnCopy(ThrowsOnCopy&& other) noexcept : value(other.value) { live++; }
+  ThrowsOnCopy& operator=(const ThrowsOnCopy&) = default;
+  ThrowsOnCopy& operator=(ThrowsOnCopy&&) noexcept = default;
+  ~ThrowsOnCopy() { live--; }
+
+  int value;
+};
+
+TEST_CASE("Throwing insert into free capacity destroys each element once") {
+  {
+    Vector<ThrowsOnCopy> vector;
+    vector.reserve(8);
+    for (int i = 0; i < 4; i++)
+      vector.emplace_back(i);
+    ThrowsOnCopy extra(9);
+    ThrowsOnCopy::copies_left = 2;
+    REQUIRE_THROWS_AS(vector.insert(vector.begin() + 1, 2, extra), std::runtime_error);
+    ThrowsOnCopy::copies_left = -1;
+    REQUIRE(vector.size() == 1);
+    REQUIRE(vector[0].value == 0);
+    REQUIRE(ThrowsOnCopy::live == 2);
+  }
+  REQUIRE(ThrowsOnCopy::live == 0);
+}
+
+//Move may throw, so reallocation copies and a failed copy must leave the source intact
+struct CopiedOnGrowth {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  CopiedOnGrowth(int value = 0) : value(value) { live++; }
+  CopiedOnGrowth(const CopiedOnGrowth& other) : value(other.value) {
+    if (copies_left >= 0 && !copies_left--)
+      throw std::runtime_error("copy");
+    live++;
+  }
+  CopiedOnGrowth(CopiedOnGrowth&& other) noexcept(false) : value(other.value) { live++; }
+  CopiedOnGrowth& operator=(const CopiedOnGrowth&) = default;
+  CopiedOnGrowth& operator=(CopiedOnGrowth&&) = default;
+  ~CopiedOnGrowth() { live--; }
+
+  int value;
+};
+
+TEST_CASE("Throwing copy during reallocation leaves the elements in place") {
+  {
+    Vector<CopiedOnGrowth> vector;
+    for (int i = 0; i < 4; i++)
+      vector.emplace_back(i);
+    vector.shrink_to_fit();
+    CopiedOnGrowth::copies_left = 2;
+    REQUIRE_THROWS_AS(vector.emplace(vector.begin() + 2, 9), std::runtime_error);
+    CopiedOnGrowth::copies_left = 2;
+    REQUIRE_THROWS_AS(vector.reserve(16), std::runtime_error);
+    CopiedOnGrowth::copies_left = -1;
+    REQUIRE(vector.size() == 4);
+    REQUIRE(vector.capacity() == 4);
+    for (int i = 0; i < 4; i++)
+      REQUIRE(vector[i].value == i);
+    REQUIRE(CopiedOnGrowth::live == 4);
+  }
+  REQUIRE(CopiedOnGrowth::live == 0);
+}
+
+TEST_CASE("Insert rhs of move only type") {
+  Vector<std::unique_ptr<int>> vector;
+  vector.push_back(std::make_unique<int>(1));
+  vector.push_back(std::make_unique<int>(3));
+  vector.insert(vector.begin() + 1, std::make_unique<int>(2));
+  vector.insert(vector.begin(), std::make_unique<int>(0));
+
+  REQUIRE(vector.size() == 4);
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(*vector[i] == static_cast<int>(i));
+}
+
 TEST_CASE("Operator= copy") {
   size_t size = 3;
   Vector<double> vector = { 9.5, 36.6, -3.14 };
@@ -329,6 +478,56 @@ TEST_CASE("Operator= copy") {
     REQUIRE(new_vector[i] == vector[i]);
 }
 
+TEST_CASE("Operator= copy keeps source alive") {
+  Vector<std::string> vector = { "copy", "me" };
+  {
+    Vector<std::string> new_vector = { "old" };
+    new_vector = vector;
+    new_vector[0] = "changed";
+  }
+  REQUIRE(vector.size() == 2);
+  REQUIRE(vector[0] == "copy");
+  REQUIRE(vector[1] == "me");
+}
+
+//Restores the global streaming threshold even when a REQUIRE fails
+struct StreamingThresholdGuard {
+  explicit StreamingThresholdGuard(size_t bytes) : old_threshold(streaming::threshold()) {
+    streaming::set_threshold(bytes);
+  }
+  ~StreamingThresholdGuard() {
+    streaming::set_threshold(old_threshold);
+  }
+
+  size_t old_threshold;
+};
+
+TEST_CASE("Streaming copy of large trivially copyable vector") {
+  StreamingThresholdGuard streaming_everything(0);
+  REQUIRE(streaming::threshold() == 0);
+
+  size_t size = 1003;
+  Vector<double> filled(size, 2.5);
+  for (size_t i = 0; i < size; i++)
+    REQUIRE(filled[i] == 2.5);
+
+  Vector<int> vector;
+  for (int i = 0; i < 1001; i++)
+    vector.push_back(i);
+  Vector<int> copied(vector);
+  Vector<int> assigned;
+  assigned = vector;
+  vector.reserve(5000);
+
+  REQUIRE(copied.size() == 1001);
+  REQUIRE(assigned.size() == 1001);
+  for (int i = 0; i < 1001; i++) {
+    REQUIRE(copied[i] == i);
+    REQUIRE(assigned[i] == i);
+    REQUIRE(vector[i] == i);
+  }
+}
+
 TEST_CASE("Operator= move") {
   size_t size = 3;
   Vector<double> vector = { 9.5, 36.6, -3.14 };
@@ -465,6 +664,15 @@ TEST_CASE("Resize") {
     REQUIRE(vector[i] == expected_vector[i]);
 }
 
+TEST_CASE("Push back and resize from an element of a full vector") {
+  Vector<std::string> vector = { "first", "second" };
+  REQUIRE(vector.size() == vector.capacity());
+  vector.push_back(vector[0]);
+  vector.emplace_back(vector[1]);
+  vector.resize(6, vector[0]);
+  REQUIRE((vector == Vector<std::string>{ "first", "second", "first", "second", "first", "first" }));
+}
+
 TEST_CASE("Swap") {
   Vector<int> odd_vector = { 2, 4, 6 };
   Vector<int> no_odd_vector = { 1, 3, 5 };
@@ -539,6 +747,46 @@ TEST_CASE("Iterator") {
   REQUIRE(first == last);
 }
 
+TEST_CASE("Contiguous iterator") {
+  static_assert(std::contiguous_iterator<Vector<int>::iterator>);
+  static_assert(std::contiguous_iterator<Vector<int>::const_iterator>);
+  static_assert(std::ranges::contiguous_range<Vector<int>>);
+
+  Vector<int> vector = { 1, 2, 3, 4, 5 };
+  REQUIRE(std::to_address(vector.begin()) == vector.data());
+  REQUIRE(std::to_address(vector.end()) == vector.data() + vector.size());
+
+  Vector<int>::const_iterator first = vector.begin();
+  REQUIRE(first == vector.cbegin());
+  REQUIRE(vector.end() - first == 5);
+
+  Vector<int> copied(5);
+  std::copy(vector.begin(), vector.end(), copied.begin());
+  REQUIRE(std::equal(vector.begin(), vector.end(), copied.begin()));
+  std::fill(copied.begin() + 1, copied.end() - 1, 0);
+  REQUIRE(std::find(copied.begin(), copied.end(), 5) == copied.end() - 1);
+  REQUIRE(copied[2] == 0);
+}
+
+TEST_CASE("Insert and erase on non trivial elements") {
+  Vector<std::string> vector = { "a", "b", "c", "d", "e" };
+  vector.erase(vector.begin() + 1, vector.begin() + 3);
+  vector.insert(vector.begin() + 1, 2, std::string("x"));
+  vector.erase(vector.begin());
+  vector.insert(vector.end(), { "y", "z" });
+  vector.pop_back();
+
+  std::vector<std::string> expected_vector = { "x", "x", "d", "e", "y" };
+  REQUIRE(vector.size() == expected_vector.size());
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(vector[i] == expected_vector[i]);
+
+  Vector<int> numbers = { 1, 2 };
+  numbers.insert(numbers.begin() + 1, 2, 7);
+  REQUIRE(numbers.size() == 4);
+  REQUIRE(numbers[2] == 7);
+}
+
 TEST_CASE("Vector's compare") {
   SECTION("EQUAL") {
     Vector<int> first = { 5, 6, 8, 9 };
@@ -592,4 +840,1085 @@ TEST_CASE("Swap non member") {
     REQUIRE(odd_vector[i] % 2 == 1);
     REQUIRE(no_odd_vector[i] % 2 == 0);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Compressed vector of sorted ids") {
+  Vector<int64_t> ids;
+  for (int64_t i = 0; i < 1000; i++)
+    ids.push_back(1000000 + i * 3 + (i % 2));
+
+  CompressedVector<int64_t> compressed(ids);
+  REQUIRE(compressed.size() == ids.size());
+  REQUIRE(compressed.block_count() == 8);
+  REQUIRE(compressed.compressed_bytes() < ids.size() * sizeof(int64_t) / 4);
+  for (size_t i = 0; i < ids.size(); i++)
+    REQUIRE(compressed[i] == ids[i]);
+  REQUIRE(compressed.back() == ids.back());
+  REQUIRE_THROWS_AS(compressed.at(ids.size()), std::out_of_range);
+
+  size_t i = 0;
+  for (auto it = compressed.begin(); it != compressed.end(); ++it, i++)
+    REQUIRE(*it == ids[i]);
+  REQUIRE(i == ids.size());
+
+  //Iterators decode into their own buffers, so interleaved scans and readers on
+  //several threads don't disturb each other
+  auto front = compressed.begin();
+  auto middle = compressed.begin();
+  for (size_t k = 0; k < 500; k++, ++middle)
+    REQUIRE(*middle == ids[k]);
+  for (size_t k = 0; k < 500; k++, ++front, ++middle) {
+    REQUIRE(*front == ids[k]);
+    REQUIRE(*middle == ids[500 + k]);
+  }
+  const CompressedVector<int64_t>& shared = compressed;
+  std::atomic<size_t> mismatches(0);
+  auto read_all = [&] {
+    for (size_t k = 0; k < ids.size(); k++)
+      if (shared[ids.size() - 1 - k] != ids[ids.size() - 1 - k])
+        mismatches++;
+  };
+  std::thread reader(read_all);
+  read_all();
+  reader.join();
+  REQUIRE(mismatches == 0);
+
+  REQUIRE(compressed.to_vector() == ids);
+}
+
+TEST_CASE("Compressed vector of unsorted and negative values") {
+  Vector<int> values;
+  for (int i = 0; i < 300; i++)
+    values.push_back((i * 7919) % 201 - 100);
+  values.push_back(std::numeric_limits<int>::min());
+  values.push_back(std::numeric_limits<int>::max());
+  for (int i = 0; i < 200; i++)
+    values.push_back(-5);
+
+  CompressedVector<int> compressed;
+  for (size_t i = 0; i < values.size(); i++)
+    compressed.push_back(values[i]);
+
+  REQUIRE(compressed.size() == values.size());
+  for (size_t i = 0; i < values.size(); i++)
+    REQUIRE(compressed[i] == values[i]);
+  REQUIRE(compressed.to_vector() == values);
+}
+
+TEST_CASE("Fused element-wise expressions") {
+  Vector<double> a = { 1, 2, 3, 4 };
+  Vector<double> b = { 0.5, 0.5, 2, 2 };
+  Vector<double> d = { 10, 20, 30, 40 };
+
+  Vector<double> c;
+  c = a * b + d;
+  std::vector<double> expected_vector = { 10.5, 21, 36, 48 };
+  REQUIRE(c.size() == 4);
+  for (size_t i = 0; i < c.size(); i++)
+    REQUIRE(c[i] == expected_vector[i]);
+
+  Vector<double> e = vector_expr::fma(a, 2.0, -d) / 2;
+  expected_vector = { -4, -8, -12, -16 };
+  for (size_t i = 0; i < e.size(); i++)
+    REQUIRE(e[i] == expected_vector[i]);
+
+  double* ptr = c.data();
+  c = c - a;
+  REQUIRE(c.data() == ptr);
+  REQUIRE(c[3] == 44);
+
+  Vector<bool> mask = vector_expr::greater(a, 2.5);
+  REQUIRE(mask.size() == 4);
+  REQUIRE(mask[1] == false);
+  REQUIRE(mask[2] == true);
+
+  REQUIRE(vector_expr::sum(a) == 10);
+  REQUIRE(vector_expr::dot(a, b) == 15.5);
+  REQUIRE(vector_expr::max(a - d) == -9);
+  REQUIRE(vector_expr::min(a * b) == 0.5);
+  REQUIRE(vector_expr::any(vector_expr::equal_to(a, 3)));
+  REQUIRE(!vector_expr::all(vector_expr::less(a, 4)));
+
+  Vector<double> empty;
+  REQUIRE(vector_expr::sum(empty * 2.0) == 0);
+  REQUIRE(vector_expr::dot(empty, empty) == 0);
+  REQUIRE(!vector_expr::any(vector_expr::equal_to(empty, 0)));
+  REQUIRE(vector_expr::all(vector_expr::equal_to(empty, 0)));
+  REQUIRE_THROWS_AS(vector_expr::min(empty * 2.0), std::out_of_range);
+
+  Vector<double> shorter = { 1, 2 };
+  REQUIRE_THROWS_AS(a + shorter, std::length_error);
+}
+
+TEST_CASE("Parallel expression evaluation") {
+  size_t old_threshold = vector_expr::parallel_threshold();
+  vector_expr::set_parallel_threshold(16);
+
+  size_t size = 10007;
+  Vector<int> a(size);
+  for (size_t i = 0; i < size; i++)
+    a[i] = static_cast<int>(i);
+  Vector<long long> c = a * 3 + 1;
+
+  REQUIRE(c.size() == size);
+  for (size_t i = 0; i < size; i++)
+    REQUIRE(c[i] == static_cast<long long>(i) * 3 + 1);
+  REQUIRE(vector_expr::sum(c) == static_cast<long long>(size) * static_cast<long long>(size - 1) / 2 * 3 + static_cast<long long>(size));
+
+  //Partials fold in chunk order, so rounding is the same on every run
+  Vector<double> d(size);
+  for (size_t i = 0; i < size; i++)
+    d[i] = 1.0 / static_cast<double>(i + 1) * (i % 2 ? -1e8 : 1e8);
+  double first = vector_expr::sum(d * 1.0);
+  for (int run = 0; run < 20; run++)
+    REQUIRE(vector_expr::sum(d * 1.0) == first);
+
+  vector_expr::set_parallel_threshold(old_threshold);
+}
+
+TEST_CASE("Capacity profile learns call site sizes") {
+  capacity_profile::set_min_samples(4);
+  auto fill = [](size_t count) {
+    Vector<int> vector(capacity_profile::here());
+    size_t reserved = vector.capacity();
+    for (size_t i = 0; i < count; i++)
+      vector.push_back(static_cast<int>(i));
+    vector.erase(vector.begin(), vector.begin() + count / 2);
+    return reserved;
+  };
+
+  REQUIRE(fill(100) == 0);
+  for (int i = 0; i < 10; i++)
+    fill(100);
+  size_t learned = fill(100);
+  REQUIRE(learned >= 100);
+  REQUIRE(learned <= 125);
+
+  const char* path = "capacity_profile_test.txt";
+  REQUIRE(capacity_profile::dump(path));
+  capacity_profile::reset();
+  REQUIRE(fill(100) == 0);
+  REQUIRE(capacity_profile::load(path));
+  REQUIRE(fill(100) >= 100);
+  std::remove(path);
+  capacity_profile::set_min_samples(8);
+}
+
+TEST_CASE("Double buffered handoff") {
+  DoubleBufferedVector<int> buffers(4);
+  REQUIRE(buffers.acquire() == nullptr);
+
+  buffers.back().push_back(1);
+  buffers.back().push_back(2);
+  REQUIRE(buffers.publish());
+  buffers.back().push_back(3);
+  REQUIRE(buffers.publish());
+  REQUIRE(buffers.writable() == false);
+  REQUIRE(buffers.publish() == false);
+  REQUIRE(buffers.published() == 2);
+
+  Vector<int>* batch = buffers.acquire();
+  REQUIRE(batch->size() == 2);
+  REQUIRE((*batch)[1] == 2);
+  int* ptr = batch->data();
+  buffers.release();
+  REQUIRE(buffers.writable());
+  REQUIRE(buffers.back().empty());
+  REQUIRE(buffers.back().data() == ptr);
+  REQUIRE(buffers.back().capacity() == 4);
+
+  Vector<int> taken;
+  REQUIRE(buffers.take(taken));
+  REQUIRE(taken.size() == 1);
+  REQUIRE(taken[0] == 3);
+  REQUIRE(buffers.take(taken) == false);
+}
+
+TEST_CASE("Double buffered handoff between threads") {
+  DoubleBufferedVector<int, 3> buffers(64);
+  const int batches = 2000;
+
+  std::thread producer([&buffers] {
+    for (int batch = 0; batch < batches; batch++) {
+      while (!buffers.writable())
+        std::this_thread::yield();
+      for (int i = 0; i < 64; i++)
+        buffers.back().push_back(batch);
+      buffers.publish();
+    }
+  });
+
+  long long total = 0;
+  int received = 0;
+  Vector<int> batch;
+  while (received < batches) {
+    if (!buffers.take(batch)) {
+      std::this_thread::yield();
+      continue;
+    }
+    REQUIRE(batch.size() == 64);
+    REQUIRE(batch.capacity() == 64);
+    for (size_t i = 0; i < batch.size(); i++)
+      total += batch[i];
+    received++;
+  }
+  producer.join();
+  REQUIRE(total == 64LL * batches * (batches - 1) / 2);
+}
+
+TEST_CASE("Range constructor and append_range") {
+  std::vector<int> source = { 1, 2, 3, 4, 5, 6 };
+  Vector<int> squares(from_range, source | std::views::transform([](int x) { return x * x; }));
+  REQUIRE(squares.size() == 6);
+  REQUIRE(squares.capacity() == 6);
+  REQUIRE(squares[5] == 36);
+
+  squares.append_range(source | std::views::filter([](int x) { return x % 2 == 0; }));
+  std::vector<int> expected_vector = { 1, 4, 9, 16, 25, 36, 2, 4, 6 };
+  REQUIRE(squares.size() == expected_vector.size());
+  REQUIRE(squares.capacity() == 12);
+  for (size_t i = 0; i < squares.size(); i++)
+    REQUIRE(squares[i] == expected_vector[i]);
+
+  std::istringstream stream("7 8 9 10 11");
+  Vector<int> parsed;
+  parsed.append_range(std::views::istream<int>(stream));
+  REQUIRE(parsed.size() == 5);
+  REQUIRE(parsed.capacity() == 8);
+  REQUIRE(parsed.back() == 11);
+}
+
+TEST_CASE("Insert_range and assign_range") {
+  Vector<std::string> vector = { "a", "b", "c", "d" };
+  std::vector<std::string> middle = { "x", "y" };
+  vector.insert_range(vector.begin() + 1, middle);
+  std::vector<std::string> expected_vector = { "a", "x", "y", "b", "c", "d" };
+  REQUIRE(vector.size() == expected_vector.size());
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(vector[i] == expected_vector[i]);
+
+  std::vector<std::string> longer = { "1", "2", "3", "4", "5", "6", "7" };
+  vector.insert_range(vector.end() - 1, longer);
+  expected_vector = { "a", "x", "y", "b", "c", "1", "2", "3", "4", "5", "6", "7", "d" };
+  REQUIRE(vector.size() == expected_vector.size());
+  for (size_t i = 0; i < vector.size(); i++)
+    REQUIRE(vector[i] == expected_vector[i]);
+
+  std::istringstream stream("p q");
+  vector.insert_range(vector.begin(), std::views::istream<std::string>(stream));
+  REQUIRE(vector.size() == expected_vector.size() + 2);
+  REQUIRE(vector[0] == "p");
+  REQUIRE(vector[1] == "q");
+  REQUIRE(vector[2] == "a");
+  REQUIRE(vector.back() == "d");
+
+  vector.assign_range(std::views::iota(0, 3) | std::views::transform([](int x) { return std::to_string(x); }));
+  REQUIRE(vector.size() == 3);
+  REQUIRE(vector[2] == "2");
+}
+
+TEST_CASE("Virtual memory backed vector grows in place") {
+  using VmVector = Vector<long long, VirtualMemoryAllocator<long long>>;
+  VmVector vector(VirtualMemoryAllocator<long long>(size_t(1) << 21));
+  vector.push_back(0);
+  long long* ptr = vector.data();
+  long long& first = vector[0];
+
+  for (long long i = 1; i < 100000; i++)
+    vector.push_back(i);
+  REQUIRE(vector.data() == ptr);
+  REQUIRE(&first == ptr);
+
+  vector.insert(vector.begin() + 1, -1);
+  REQUIRE(vector.data() == ptr);
+  REQUIRE(vector[1] == -1);
+  vector.erase(vector.begin() + 1);
+
+  vector.reserve(size_t(1) << 18);
+  REQUIRE(vector.capacity() == size_t(1) << 18);
+  for (long long i = 0; i < 100000; i++)
+    REQUIRE(vector[i] == i);
+
+  vector.shrink_to_fit();
+  REQUIRE(vector.capacity() == 100000);
+  REQUIRE(vector.back() == 99999);
+
+  VmVector moved(std::move(vector));
+  REQUIRE(vector.data() == nullptr);
+  vector.push_back(2);
+  REQUIRE(vector.size() == 1);
+  REQUIRE(vector[0] == 2);
+  REQUIRE(moved.back() == 99999);
+}
+
+TEST_CASE("Virtual memory vectors with the default reservation") {
+  using VmVector = Vector<int, VirtualMemoryAllocator<int>>;
+  Vector<VmVector> vectors;
+  vectors.reserve(10000);
+  for (int i = 0; i < 10000; i++) {
+    vectors.emplace_back();
+    vectors.back().push_back(i);
+  }
+  REQUIRE(VmVector().data() == nullptr);
+
+  VmVector growing;
+  for (int i = 0; i < 5000; i++)
+    growing.push_back(i);
+  for (int i = 0; i < 5000; i++)
+    REQUIRE(growing[i] == i);
+  REQUIRE(vectors[9999][0] == 9999);
+}
+
+TEST_CASE("Parallel concat of thread local vectors") {
+  VectorBuilder<int> builder(4);
+  //Every local Vector starts a cache line of its own
+  for (size_t part = 0; part < builder.parts(); part++)
+    REQUIRE(reinterpret_cast<std::uintptr_t>(&builder.local(part)) % 64 == 0);
+  Vector<std::thread> threads;
+  for (size_t part = 0; part < builder.parts(); part++)
+    threads.emplace_back([&builder, part] {
+      for (int i = 0; i < 20000 * static_cast<int>(part + 1); i++)
+        builder.local(part).push_back(static_cast<int>(part));
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  int* local_ptr = builder.local(3).data();
+  Vector<int> result = builder.build(3);
+  REQUIRE(result.size() == 200000);
+  REQUIRE(result.capacity() == 200000);
+  REQUIRE(result[0] == 0);
+  REQUIRE(result[20000] == 1);
+  REQUIRE(result[60000] == 2);
+  REQUIRE(result.back() == 3);
+  REQUIRE(builder.local(3).empty());
+  REQUIRE(builder.local(3).data() == local_ptr);
+}
+
+TEST_CASE("Parallel concat copies and moves non trivial elements") {
+  Vector<Vector<std::string>> parts;
+  parts.push_back({ "a", "b" });
+  parts.push_back({});
+  parts.push_back({ "c" });
+
+  Vector<std::string> copied = parallel_concat(static_cast<const Vector<Vector<std::string>>&>(parts), 2);
+  std::vector<std::string> expected_vector = { "a", "b", "c" };
+  REQUIRE(copied.size() == 3);
+  for (size_t i = 0; i < copied.size(); i++)
+    REQUIRE(copied[i] == expected_vector[i]);
+  REQUIRE(parts[0].size() == 2);
+
+  Vector<std::string> moved = parallel_concat(parts, 2);
+  REQUIRE(moved.size() == 3);
+  for (size_t i = 0; i < moved.size(); i++)
+    REQUIRE(moved[i] == expected_vector[i]);
+  REQUIRE(parts[0].empty());
+}
+
+TEST_CASE("Hashing vectors by content") {
+  Vector<int> first = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17 };
+  Vector<int> second(first);
+  std::hash<Vector<int>> hasher;
+  REQUIRE(hasher(first) == hasher(second));
+  second[16] = 0;
+  REQUIRE(hasher(first) != hasher(second));
+  REQUIRE(hasher(Vector<int>{}) != hasher(Vector<int>{ 0 }));
+
+  Vector<char> chars = { 'a', 'b', 'c' };
+  REQUIRE(std::hash<Vector<char>>()(chars) == vector_hash::hash_bytes("abc", 3));
+
+  Vector<std::string> strings = { "one", "two" };
+  Vector<std::string> same_strings = { "one", "two" };
+  REQUIRE(std::hash<Vector<std::string>>()(strings) == std::hash<Vector<std::string>>()(same_strings));
+
+  std::unordered_set<Vector<double>> doubles;
+  doubles.insert(Vector<double>{ 0.5, 1.5 });
+  REQUIRE(doubles.count(Vector<double>{ 0.5, 1.5 }) == 1);
+}
+
+TEST_CASE("Heterogeneous lookup with spans") {
+  std::unordered_map<Vector<int>, int, VectorHash<int>, VectorEqual<int>> fingerprints;
+  fingerprints.emplace(Vector<int>{ 4, 8, 15 }, 1);
+  fingerprints.emplace(Vector<int>{ 16, 23, 42 }, 2);
+
+  int raw[] = { 16, 23, 42 };
+  auto it = fingerprints.find(std::span<const int>(raw, 3));
+  REQUIRE(it != fingerprints.end());
+  REQUIRE(it->second == 2);
+  REQUIRE(fingerprints.find(std::span<const int>(raw, 2)) == fingerprints.end());
+
+  std::unordered_set<HashedVector<int>, VectorHash<int>, VectorEqual<int>> cached;
+  cached.emplace(Vector<int>{ 1, 2, 3 });
+  REQUIRE(cached.begin()->hash() == VectorHash<int>()(Vector<int>{ 1, 2, 3 }));
+  int key[] = { 1, 2, 3 };
+  REQUIRE(cached.find(std::span<const int>(key, 3)) != cached.end());
+}
+
+TEST_CASE("Memory registry accounting") {
+  memory_registry::enable();
+  {
+    Vector<short> tagged;
+    tagged.memory_tag("registry-test");
+    tagged.reserve(100);
+    memory_registry::Entry* entry = memory_registry::find_entry(memory_registry::type_name<short>(), "registry-test");
+    for (short i = 0; i < 40; i++)
+      tagged.push_back(i);
+    REQUIRE(entry->used_bytes.load() == 40 * sizeof(short));
+    tagged.pop_back();
+    tagged.erase(tagged.begin());
+    REQUIRE(entry->used_bytes.load() == 38 * sizeof(short));
+    tagged.insert(tagged.begin(), 2, short(7));
+    tagged.shrink_to_fit();
+    tagged.reserve(50);
+
+    REQUIRE(std::string(memory_registry::type_name<short>()).find("short") != std::string::npos);
+    REQUIRE(entry->instances.load() == 1);
+    REQUIRE(entry->allocated_bytes.load() == 50 * sizeof(short));
+    REQUIRE(entry->used_bytes.load() == 40 * sizeof(short));
+    REQUIRE(entry->peak_bytes.load() == 100 * sizeof(short));
+
+    Vector<short> moved(std::move(tagged));
+    REQUIRE(entry->instances.load() == 1);
+    moved.clear();
+    REQUIRE(entry->used_bytes.load() == 0);
+
+    char buffer[memory_registry::kSnapshotSize];
+    memory_registry::format_json(buffer, sizeof(buffer));
+    std::string json = buffer;
+    REQUIRE(json.find("\"tag\": \"registry-test\"") != std::string::npos);
+    REQUIRE(json.find("\"slack_bytes\": 100") != std::string::npos);
+    memory_registry::format_text(buffer, sizeof(buffer));
+    REQUIRE(std::string(buffer).find("[registry-test] instances=1 used=0 slack=100") != std::string::npos);
+  }
+  memory_registry::Entry* entry = memory_registry::find_entry(memory_registry::type_name<short>(), "registry-test");
+  REQUIRE(entry->instances.load() == 0);
+  REQUIRE(entry->allocated_bytes.load() == 0);
+  memory_registry::enable(false);
+}
+
+TEST_CASE("Strided views and blocked kernels") {
+  const std::size_t rows = 70, cols = 130;
+  Vector<double> storage(rows * cols);
+  MatrixView<double> matrix(storage, { rows, cols });
+  for (std::size_t r = 0; r < rows; r++)
+    for (std::size_t c = 0; c < cols; c++)
+      matrix(r, c) = r * 1000.0 + c;
+  REQUIRE(storage[2 * cols + 5] == 2005.0);
+
+  SECTION("Views past the end of the Vector throw") {
+    REQUIRE_THROWS_AS(MatrixView<double>(storage, { rows + 1, cols }), std::length_error);
+  }
+
+  SECTION("Subview shares storage") {
+    MatrixView<double> block = matrix.subview({ 10, 20 }, { 3, 4 });
+    REQUIRE(block(0, 0) == 10020.0);
+    REQUIRE(block(2, 3) == 12023.0);
+    block(1, 1) = -1.0;
+    REQUIRE(matrix(11, 21) == -1.0);
+    REQUIRE_THROWS_AS(matrix.subview({ 68, 0 }, { 3, 1 }), std::out_of_range);
+
+    Vector<double> extracted = vector_view::to_vector(block);
+    REQUIRE(extracted.size() == 12);
+    REQUIRE(extracted[5] == -1.0);
+  }
+
+  SECTION("Transpose into column-major and back") {
+    Vector<double> transposed(rows * cols);
+    MatrixView<double> out(transposed, { cols, rows });
+    vector_view::transpose(out, MatrixView<const double>(matrix));
+    REQUIRE(out(5, 2) == 2005.0);
+    REQUIRE(out(129, 69) == 69129.0);
+    REQUIRE(matrix.transposed()(129, 69) == 69129.0);
+
+    Vector<double> column_major(rows * cols);
+    MatrixView<double> column(column_major, StridedLayout<2>::column_major({ rows, cols }));
+    vector_view::copy(column, matrix);
+    REQUIRE(column_major[5 * rows + 2] == 2005.0);
+    REQUIRE(column.layout().is_column_major());
+  }
+
+  SECTION("Tiled layout") {
+    TiledLayout layout({ rows, cols }, 16, 16);
+    REQUIRE(layout.required_size() == 5 * 9 * 256);
+    REQUIRE(layout(17, 3) == 9 * 256 + 16 + 3);
+    Vector<double> tiles(layout.required_size());
+    TiledView<double> tiled(tiles, layout);
+    vector_view::copy(tiled, matrix);
+    REQUIRE(tiled(69, 129) == 69129.0);
+
+    Vector<double> back(rows * cols, 0.0);
+    MatrixView<double> restored(back, { rows, cols });
+    vector_view::transform(restored, tiled, matrix, [](double a, double b) { return a - b; });
+    REQUIRE(std::all_of(back.begin(), back.end(), [](double v) { return v == 0.0; }));
+  }
+}
+
+TEST_CASE("CircularVector") {
+  SECTION("Queue at both ends") {
+    CircularVector<std::string> ring;
+    for (int i = 0; i < 10; i++)
+      ring.push_back(std::to_string(i));
+    ring.pop_front();
+    ring.pop_front();
+    ring.push_front("front");
+    ring.push_back("back");
+    REQUIRE(ring.size() == 10);
+    REQUIRE(ring.front() == "front");
+    REQUIRE(ring.back() == "back");
+    REQUIRE(ring[1] == "2");
+    REQUIRE_THROWS_AS(ring.at(10), std::out_of_range);
+
+    Vector<std::string> expected{ "front", "2", "3", "4", "5", "6", "7", "8", "9", "back" };
+    REQUIRE(std::equal(ring.begin(), ring.end(), expected.begin(), expected.end()));
+    REQUIRE(std::is_sorted(ring.begin() + 1, ring.end() - 1));
+    REQUIRE(*ring.rbegin() == "back");
+  }
+
+  SECTION("Wraparound and linearize") {
+    CircularVector<int> ring(8);
+    for (int i = 0; i < 6; i++)
+      ring.push_back(i);
+    for (int i = 0; i < 4; i++)
+      ring.pop_front();
+    for (int i = 6; i < 12; i++)
+      ring.push_back(i);
+    REQUIRE(ring.capacity() == 8);
+    REQUIRE(!ring.is_linearized());
+    REQUIRE(ring.end() - ring.begin() == 8);
+
+    int* data = ring.linearize();
+    REQUIRE(ring.is_linearized());
+    for (int i = 0; i < 8; i++)
+      REQUIRE(data[i] == i + 4);
+
+    ring.push_back(ring.front());
+    REQUIRE(ring.capacity() == 16);
+    REQUIRE(ring.back() == 4);
+    ring.push_front(ring.back());
+    REQUIRE(ring.front() == 4);
+
+    Vector<int> taken = ring.take();
+    REQUIRE(taken.size() == 10);
+    REQUIRE(ring.empty());
+  }
+
+  SECTION("Bounded ring overwrites the oldest element") {
+    CircularVector<int> history(4, CircularVector<int>::Overflow::OverwriteOldest);
+    for (int i = 0; i < 10; i++)
+      history.push_back(i);
+    REQUIRE(history.size() == 4);
+    REQUIRE(history.capacity() == 4);
+    REQUIRE(history.front() == 6);
+    REQUIRE(history.back() == 9);
+
+    history.push_front(-1);
+    REQUIRE(history.front() == -1);
+    REQUIRE(history.back() == 8);
+
+    CircularVector<int> copy(history);
+    REQUIRE(copy.capacity() == 4);
+    copy.push_back(42);
+    REQUIRE(copy.front() == 6);
+    REQUIRE(history.front() == -1);
+    REQUIRE_THROWS_AS(CircularVector<int>(0, CircularVector<int>::Overflow::OverwriteOldest), std::length_error);
+  }
+
+  SECTION("A copy that throws while growing leaves the ring as it was") {
+    {
+      CircularVector<CopiedOnGrowth> ring(4);
+      for (int i = 0; i < 6; i++)
+        ring.push_back(CopiedOnGrowth(i));
+      for (int i = 0; i < 2; i++)
+        ring.pop_front();
+      for (int i = 6; i < 10; i++)
+        ring.push_back(CopiedOnGrowth(i));
+      REQUIRE(ring.full());
+      REQUIRE(!ring.is_linearized());
+      CopiedOnGrowth::copies_left = 3;
+      REQUIRE_THROWS_AS(ring.push_back(CopiedOnGrowth(10)), std::runtime_error);
+      CopiedOnGrowth::copies_left = -1;
+      REQUIRE(ring.capacity() == 8);
+      for (int i = 0; i < 8; i++)
+        REQUIRE(ring[i].value == i + 2);
+      ring.push_back(CopiedOnGrowth(10));
+      REQUIRE(ring.capacity() == 16);
+      REQUIRE(ring.back().value == 10);
+      REQUIRE(ring.front().value == 2);
+    }
+    REQUIRE(CopiedOnGrowth::live == 0);
+  }
+}
+
+TEST_CASE("GapBuffer edits around a cursor") {
+  std::string text = "hello world";
+  GapBuffer<char> buffer(text.begin(), text.end());
+  REQUIRE(buffer.size() == 11);
+  REQUIRE(buffer.cursor() == 11);
+
+  buffer.insert(5, ',');
+  REQUIRE(buffer.cursor() == 6);
+  buffer.insert(6, 3, '!');
+  buffer.erase_before_cursor(2);
+  REQUIRE(std::string(buffer.begin(), buffer.end()) == "hello,! world");
+
+  buffer.erase(0, 5);
+  buffer.insert(0, 'H');
+  std::string tail = " again";
+  buffer.insert(buffer.size(), tail.begin(), tail.end());
+  REQUIRE(std::string(buffer.begin(), buffer.end()) == "H,! world again");
+  REQUIRE(buffer[1] == ',');
+  REQUIRE(buffer.end() - buffer.begin() == 15);
+  REQUIRE(std::find(buffer.begin(), buffer.end(), 'w').index() == 4);
+  REQUIRE_THROWS_AS(buffer.at(15), std::out_of_range);
+  REQUIRE_THROWS_AS(buffer.move_cursor(16), std::out_of_range);
+
+  std::span<char> flat = buffer.contiguous();
+  REQUIRE(std::string(flat.begin(), flat.end()) == "H,! world again");
+
+  buffer.move_cursor(3);
+  const char* storage = &buffer[0];
+  Vector<char> released = buffer.release();
+  REQUIRE(released.data() == storage);
+  REQUIRE(std::string(released.begin(), released.end()) == "H,! world again");
+  REQUIRE(buffer.empty());
+
+  GapBuffer<std::string> lines{ "a", "b" };
+  for (int i = 0; i < 200; i++)
+    lines.insert(1, std::to_string(i));
+  lines.erase(1, 199);
+  REQUIRE(lines.size() == 3);
+  REQUIRE(lines[1] == "0");
+  REQUIRE(lines[2] == "b");
+}
+
+TEST_CASE("StringColumn") {
+  Vector<std::string> words{ "pear", "apple", "fig", "banana", "cherry" };
+  StringColumn column(words.begin(), words.end());
+  REQUIRE(column.size() == 5);
+  REQUIRE(column.char_size() == 24);
+  REQUIRE(column[1] == "apple");
+  REQUIRE(column.back() == "cherry");
+  REQUIRE_THROWS_AS(column.at(5), std::out_of_range);
+  REQUIRE(std::equal(column.begin(), column.end(), words.begin(), words.end()));
+
+  SECTION("Sort and compact") {
+    StringColumn<> sorted_column = column;
+    sorted_column.sort();
+    StringColumn<> sorted{ "apple", "banana", "cherry", "fig", "pear" };
+    REQUIRE(sorted_column == sorted);
+    REQUIRE(sorted_column.entries()[0].offset == 4);
+    sorted_column.compact();
+    REQUIRE(sorted_column == sorted);
+    REQUIRE(sorted_column.entries()[0].offset == 0);
+    REQUIRE(std::string_view(sorted_column.chars().data(), sorted_column.char_size()) == "applebananacherryfigpear");
+  }
+
+  SECTION("Replace, erase and compact") {
+    StringColumn<> edited = column;
+    edited.set(0, "kiwi");
+    REQUIRE(edited.garbage_bytes() == 0);
+    edited.set(2, "grapefruit");
+    REQUIRE(edited.garbage_bytes() == 3);
+    edited.set(4, edited[2]);
+    REQUIRE(edited[4] == "grapefruit");
+    edited.erase(1);
+    REQUIRE(edited.size() == 4);
+    REQUIRE(edited.garbage_bytes() == 14);
+    edited.push_back("lime");
+    edited.pop_back();
+    REQUIRE(edited.garbage_bytes() == 14);
+
+    std::size_t before = edited.char_size();
+    edited.compact();
+    REQUIRE(edited.char_size() == before - 14);
+    REQUIRE(edited.garbage_bytes() == 0);
+    StringColumn<> expected{ "kiwi", "grapefruit", "banana", "grapefruit" };
+    REQUIRE(edited == expected);
+  }
+
+  SECTION("Many short strings") {
+    StringColumn<> many;
+    for (int i = 0; i < 10000; i++)
+      many.push_back(std::to_string(i));
+    REQUIRE(many[9999] == "9999");
+    REQUIRE(many.memory_bytes() < 10000 * sizeof(std::string));
+    REQUIRE(std::ranges::distance(many) == 10000);
+  }
+}
+
+TEST_CASE("SparseVector") {
+  Vector<float> dense(1000, 0.0f);
+  Vector<float> other(1000, 0.0f);
+  for (std::size_t i = 0; i < 1000; i += 7)
+    dense[i] = float(i % 13);
+  for (std::size_t i = 0; i < 1000; i++)
+    other[i] = float(i % 5) - 2.0f;
+
+  SparseVector<float> sparse(dense);
+  REQUIRE(sparse.dimension() == 1000);
+  REQUIRE(sparse.nnz() == 132);
+  REQUIRE(sparse[14] == 1.0f);
+  REQUIRE(sparse[15] == 0.0f);
+  REQUIRE(sparse.to_dense() == dense);
+
+  SECTION("Dot products") {
+    float expected = 0.0f;
+    for (std::size_t i = 0; i < 1000; i++)
+      expected += dense[i] * other[i];
+    REQUIRE(sparse.dot(other) == expected);
+    REQUIRE(sparse.dot(SparseVector<float>(other)) == expected);
+    REQUIRE_THROWS_AS(sparse.dot(Vector<float>(10)), std::length_error);
+
+    SparseVector<float> single(1000);
+    single.append(994, 2.0f);
+    REQUIRE(single.dot(sparse) == 2.0f * dense[994]);
+  }
+
+  SECTION("Building and updating") {
+    SparseVector<double> built(10);
+    built.append(2, 1.5);
+    built.append(7, -1.0);
+    REQUIRE_THROWS_AS(built.append(7, 3.0), std::out_of_range);
+    built.set(4, 2.0);
+    built.set(7, 0.0);
+    REQUIRE((built.indices() == Vector<std::uint32_t>{ 2, 4 }));
+    REQUIRE((built.values() == Vector<double>{ 1.5, 2.0 }));
+    using NarrowSparse = SparseVector<float, std::uint8_t>;
+    REQUIRE_THROWS_AS(NarrowSparse(257), std::length_error);
+  }
+
+  SECTION("Sum and k-way merge") {
+    SparseVector<int> a(8), b(8), c(8);
+    a.append(1, 1);
+    a.append(5, 2);
+    b.append(0, 3);
+    b.append(5, -2);
+    c.append(5, 4);
+    c.append(7, 1);
+
+    SparseVector<int> ab = a + b;
+    REQUIRE((ab.indices() == Vector<std::uint32_t>{ 0, 1 }));
+
+    Vector<SparseVector<int>> parts{ a, b, c };
+    SparseVector<int> merged = SparseVector<int>::merge(parts);
+    REQUIRE((merged.indices() == Vector<std::uint32_t>{ 0, 1, 5, 7 }));
+    REQUIRE((merged.values() == Vector<int>{ 3, 1, 4, 1 }));
+    REQUIRE(merged == (ab + c));
+  }
+}
+
+TEST_CASE("SpillableVector pages chunks through a temp file") {
+  //Chunks of 1024 ints, at most four resident
+  SpillableVector<int> spilled(4 * 4096, 4096);
+  REQUIRE(spilled.chunk_size() == 1024);
+  for (int i = 0; i < 10000; i++)
+    spilled.push_back(i);
+  Vector<int> bulk(5000);
+  for (int i = 0; i < 5000; i++)
+    bulk[i] = 10000 + i;
+  spilled.append(bulk.data(), bulk.size());
+
+  REQUIRE(spilled.size() == 15000);
+  REQUIRE(spilled.resident_chunks() == 4);
+  REQUIRE(spilled.resident_bytes() <= 4 * 4096);
+  REQUIRE(spilled.spills() > 0);
+
+  long long sum = 0;
+  spilled.for_each_chunk([&](const int* data, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++)
+      sum += data[i];
+  });
+  REQUIRE(sum == 15000LL * 14999 / 2);
+
+  //Chunks that were only read are dropped on eviction, not written back
+  for (int i = 0; i < 15000; i++)
+    sum -= spilled[i];
+  REQUIRE(sum == 0);
+  std::size_t spills = spilled.spills();
+  for (int i = 0; i < 15000; i++)
+    sum += spilled[i];
+  REQUIRE(spilled.spills() == spills);
+
+  REQUIRE(spilled[3] == 3);
+  spilled.set(3, -3);
+  spilled.mutate(4) *= -1;
+  for (int i = 5000; i < 15000; i += 1024)
+    sum += spilled[i];
+  REQUIRE(spilled.spills() == spills + 1);
+  REQUIRE(spilled.at(3) == -3);
+  REQUIRE(spilled[4] == -4);
+  REQUIRE_THROWS_AS(spilled.at(15000), std::out_of_range);
+  REQUIRE_THROWS_AS(spilled.set(15000, 0), std::out_of_range);
+
+  int window[8];
+  spilled.read(1020, window, 8);
+  REQUIRE(window[0] == 1020);
+  REQUIRE(window[7] == 1027);
+
+  for (int i = 0; i < 5001; i++)
+    spilled.pop_back();
+  REQUIRE(spilled.size() == 9999);
+  spilled.push_back(-1);
+  REQUIRE(spilled[9999] == -1);
+  REQUIRE(spilled[9998] == 9998);
+
+  //Both reads are copies, so paging in the second chunk can't change the first value
+  SpillableVector<int> single(4096, 4096);
+  for (int i = 0; i < 4096; i++)
+    single.push_back(i);
+  REQUIRE(std::min(single[3000], single[10]) == 10);
+}
+
+template<class T>
+struct LifetimeCountingAllocator {
+  using value_type = T;
+
+  LifetimeCountingAllocator() = default;
+  template<class U>
+  LifetimeCountingAllocator(const LifetimeCountingAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template<class... Args>
+  void construct(T* ptr, Args&&... args) {
+    constructs()++;
+    ::new (static_cast<void*>(ptr)) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(T* ptr) {
+    destroys()++;
+    ptr->~T();
+  }
+
+  static int& constructs() {
+    static int count = 0;
+    return count;
+  }
+
+  static int& destroys() {
+    static int count = 0;
+    return count;
+  }
+
+  friend bool operator==(const LifetimeCountingAllocator&, const LifetimeCountingAllocator&) {
+    return true;
+  }
+};
+
+TEST_CASE("Bulk lifetime operations on trivial types") {
+  SECTION("Fills and shrinks keep their values") {
+    Vector<int> zeros(1000);
+    REQUIRE(std::all_of(zeros.begin(), zeros.end(), [](int v) { return v == 0; }));
+    Vector<double> filled(1000, 2.5);
+    filled.resize(1500, -1.0);
+    REQUIRE(filled[999] == 2.5);
+    REQUIRE(filled[1000] == -1.0);
+    filled.insert(filled.begin() + 10, 5, 7.0);
+    REQUIRE(filled[14] == 7.0);
+    REQUIRE(filled[15] == 2.5);
+    filled.erase(filled.begin(), filled.begin() + 500);
+    REQUIRE(filled.size() == 1005);
+    filled.resize(3);
+    filled.clear();
+    REQUIRE(filled.empty());
+    REQUIRE(filled.capacity() == 3000);
+  }
+
+  SECTION("Allocators with construct and destroy still see every element") {
+    using Counted = LifetimeCountingAllocator<int>;
+    Counted::constructs() = 0;
+    Counted::destroys() = 0;
+    {
+      Vector<int, Counted> counted(10, 3);
+      REQUIRE(Counted::constructs() == 10);
+      counted.resize(4);
+      REQUIRE(Counted::destroys() == 6);
+      counted.erase(counted.begin());
+      REQUIRE(Counted::destroys() == 7);
+    }
+    REQUIRE(Counted::destroys() == 10);
+  }
+}
+
+TEST_CASE("Operation trace round trip") {
+  const char* path = "vector_trace_test.bin";
+  REQUIRE(op_trace::start(path));
+  //The storage outlives the Vector, so its address stays a valid id after the destroy
+  std::optional<Vector<int>> traced(std::in_place);
+  const void* id = &*traced;
+  traced->reserve(4);
+  traced->push_back(1);
+  traced->push_back(2);
+  traced->insert(traced->cbegin() + 1, 3, 7);
+  traced->erase(traced->cbegin(), traced->cbegin() + 2);
+  int sum = 0;
+  for (int value : *traced)
+    sum += value;
+  REQUIRE(sum == 16);
+  traced.reset();
+  REQUIRE(op_trace::stop() >= 8);
+  REQUIRE(!op_trace::enabled());
+
+  op_trace::Reader reader(path);
+  REQUIRE(reader.valid());
+  Vector<op_trace::Record> records;
+  op_trace::Record record;
+  while (reader.next(record))
+    if (record.id == reinterpret_cast<std::uintptr_t>(id))
+      records.push_back(record);
+  std::remove(path);
+
+  Vector<op_trace::Op> ops;
+  for (const op_trace::Record& r : records)
+    ops.push_back(r.op);
+  Vector<op_trace::Op> expected{
+    op_trace::Op::Create, op_trace::Op::Reserve, op_trace::Op::PushBack, op_trace::Op::PushBack,
+    op_trace::Op::Insert, op_trace::Op::Erase, op_trace::Op::Begin, op_trace::Op::Clear, op_trace::Op::Destroy
+  };
+  REQUIRE(ops == expected);
+  REQUIRE(records[0].position == sizeof(int));
+  REQUIRE(records[4].position == 1);
+  REQUIRE(records[4].count == 3);
+  REQUIRE(records[4].size == 5);
+  REQUIRE(records[4].capacity == 8);
+  REQUIRE(records[5].count == 2);
+  REQUIRE(records[5].size == 3);
+}
+
+TEST_CASE("SlotMap handles survive erasing other values") {
+  SlotMap<std::string> entities;
+  Vector<SlotMap<std::string>::Handle> handles;
+  for (int i = 0; i < 100; i++)
+    handles.push_back(entities.insert("entity " + std::to_string(i)));
+  REQUIRE(entities.size() == 100);
+
+  REQUIRE(entities.erase(handles[10]));
+  REQUIRE(!entities.erase(handles[10]));
+  REQUIRE(!entities.contains(handles[10]));
+  REQUIRE(entities.get(handles[10]) == nullptr);
+  REQUIRE_THROWS_AS(entities.at(handles[10]), std::out_of_range);
+  REQUIRE(entities[handles[99]] == "entity 99");
+  REQUIRE(entities.data()[10] == "entity 99");
+  REQUIRE(entities.handle_at(10) == handles[99]);
+
+  for (int i = 0; i < 100; i += 2)
+    entities.erase(handles[i]);
+  REQUIRE(entities.size() == 50);
+  for (int i = 1; i < 100; i += 2)
+    REQUIRE(entities.at(handles[i]) == "entity " + std::to_string(i));
+
+  SlotMap<std::string>::Handle reused = entities.insert(entities[handles[1]]);
+  REQUIRE(entities.slot_count() == 100);
+  REQUIRE(reused.index == handles[98].index);
+  REQUIRE(reused != handles[98]);
+  REQUIRE(!entities.contains(handles[98]));
+  REQUIRE(entities[reused] == "entity 1");
+  REQUIRE(!entities.contains(SlotMap<std::string>::null_handle));
+
+  std::size_t visited = 0;
+  for (const std::string& name : entities)
+    visited += name.rfind("entity ", 0) == 0;
+  REQUIRE(visited == 51);
+
+  entities.clear();
+  REQUIRE(entities.empty());
+  REQUIRE(!entities.contains(reused));
+  SlotMap<std::string>::Handle fresh = entities.insert("fresh");
+  REQUIRE(fresh.index < 100);
+  REQUIRE(entities.slot_count() == 100);
+}
+
+TEST_CASE("DaryHeap orders like std::sort") {
+  Vector<int> values;
+  unsigned state = 12345;
+  for (int i = 0; i < 1000; i++) {
+    state = state * 1103515245u + 12345u;
+    values.push_back(static_cast<int>(state >> 16) % 500);
+  }
+  Vector<int> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+
+  SECTION("heapify then pop in descending order") {
+    DaryHeap<int> heap(values);
+    REQUIRE(heap.size() == 1000);
+    for (size_t i = sorted.size(); i-- > 0;) {
+      REQUIRE(heap.top() == sorted[i]);
+      heap.pop();
+    }
+    REQUIRE(heap.empty());
+  }
+
+  SECTION("push as a min-heap with eight children") {
+    DaryHeap<int, 8, std::greater<int>> heap;
+    for (int value : values)
+      heap.push(value);
+    for (size_t i = 0; i < sorted.size(); i++)
+      REQUIRE(heap.take_top() == sorted[i]);
+  }
+
+  SECTION("values built in place") {
+    DaryHeap<std::string> heap;
+    heap.emplace(3, 'b');
+    heap.emplace("zz");
+    heap.push("a");
+    REQUIRE(heap.take_top() == "zz");
+    REQUIRE(heap.take_top() == "bbb");
+    REQUIRE(heap.release().size() == 1);
+    REQUIRE(heap.empty());
+  }
+}
+
+TEST_CASE("IndexedDaryHeap tracks positions") {
+  IndexedDaryHeap<int, 4, std::greater<int>> timers;
+  timers.heapify(Vector<int>{ 50, 40, 30, 20, 10 });
+  REQUIRE(timers.top_id() == 4);
+  REQUIRE_THROWS_AS(timers.push(2, 1), std::invalid_argument);
+
+  timers.decrease_key(0, 5);
+  REQUIRE(timers.top_id() == 0);
+  REQUIRE_THROWS_AS(timers.decrease_key(1, 45), std::invalid_argument);
+  timers.update(0, 35);
+  REQUIRE(timers.top_id() == 4);
+  REQUIRE(timers.at(0) == 35);
+
+  REQUIRE(timers.erase(4));
+  REQUIRE(!timers.erase(4));
+  REQUIRE(!timers.contains(4));
+  timers.push(9, 1);
+  REQUIRE(timers.top_id() == 9);
+
+  Vector<uint32_t> order;
+  while (!timers.empty()) {
+    order.push_back(timers.top_id());
+    timers.pop();
+  }
+  REQUIRE((order == Vector<uint32_t>{ 9, 3, 2, 0, 1 }));
+  REQUIRE_THROWS_AS(timers.at(9), std::out_of_range);
+
+  IndexedDaryHeap<int, 8> large;
+  unsigned state = 7;
+  for (uint32_t id = 0; id < 2000; id++) {
+    state = state * 1103515245u + 12345u;
+    large.push(id, static_cast<int>(state >> 8));
+  }
+  for (uint32_t id = 0; id < 2000; id += 3)
+    large.update(id, static_cast<int>(id));
+  for (uint32_t id = 1; id < 2000; id += 7)
+    large.erase(id);
+  int previous = std::numeric_limits<int>::max();
+  size_t count = 0;
+  while (!large.empty()) {
+    REQUIRE(large.top() <= previous);
+    REQUIRE(large.at(large.top_id()) == large.top());
+    previous = large.top();
+    large.pop();
+    count++;
+  }
+  REQUIRE(count == 2000 - 286);
+}
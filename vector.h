@@ -1,8 +1,41 @@
 #pragma once
+#include "capacity_profile.h"
 #include "iterator.h"
+#include "memory_registry.h"
+#include "op_trace.h"
+#include "streaming.h"
+#include <algorithm>
 #include <allocators>
+#include <cstring>
 #include <exception>
 #include <initializer_list>
+#include <ranges>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#define VECTOR_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define VECTOR_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+//Specialized in vector_expr.h for lazy element-wise expressions
+template<class Expr>
+struct is_vector_expression : std::false_type {};
+
+//Allocators that can grow a buffer without copying it, see vm_allocator.h
+template<class Allocator>
+concept GrowsInPlace = requires(Allocator& alloc, typename std::allocator_traits<Allocator>::pointer ptr, std::size_t n) {
+  { alloc.resize_allocation(ptr, n, n) } -> std::convertible_to<typename std::allocator_traits<Allocator>::pointer>;
+};
+
+//Tag selecting the range constructor, as std::from_range does in C++23
+struct from_range_t {
+  explicit from_range_t() = default;
+};
+inline constexpr from_range_t from_range{};
+
+template<class T, class Allocator = std::allocator<T>>
+class VectorBuilder;
 
 template<class T, class Allocator = std::allocator<T>>
 class Vector {
@@ -11,36 +44,41 @@ public:
   using value_type = T;
   using allocator_type = Allocator;
   using size_type = std::size_t;
-  using differnce_type = std::ptrdiff_t;
+  using difference_type = std::ptrdiff_t;
   using reference = T&;
   using const_reference = const T&;
   using pointer = typename std::allocator_traits<Allocator>::pointer;
   using const_pointer = typename std::allocator_traits<Allocator>::const_pointer;
-  using iterator = typename Iterator<T>;
-  using const_iterator = typename const Iterator<T>;
-  using reverse_iterator = typename std::reverse_iterator<iterator>;
-  using const_reverse_iterator = typename const std::reverse_iterator<iterator>;
+  using iterator = Iterator<T>;
+  using const_iterator = Iterator<const T>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
   //Constructors
   Vector() noexcept(noexcept(Allocator()))
     : _size(0),
       _capacity(_size),
       _alloc(Allocator()),
-      _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {}
+      _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
+    trace(op_trace::Op::Create, sizeof(T), 0);
+  }
 
   explicit Vector(const Allocator& alloc) noexcept
     : _size(0),
       _capacity(_size),
       _alloc(alloc),
-      _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {}
+      _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
+    trace(op_trace::Op::Create, sizeof(T), 0);
+  }
 
   explicit Vector(size_type count, const T& value, const Allocator& alloc = Allocator())
     : _size(count),
       _capacity(_size),
       _alloc(alloc),
       _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
-    for (size_type i = 0; i < count; i++)
-      std::allocator_traits<Allocator>::construct(_alloc, _ptr + i, value);
+    fill_elements(_ptr, count, value);
+    report_memory();
+    trace(op_trace::Op::Create, sizeof(T), _size);
   }
 
   explicit Vector(size_type count, const Allocator& alloc = Allocator())
@@ -48,8 +86,13 @@ public:
       _capacity(_size),
       _alloc(alloc),
       _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
-    for (size_type i = 0; i < count; i++)
-      std::allocator_traits<Allocator>::construct(_alloc, _ptr + i);
+    if constexpr (trivially_filled)
+      fill_elements(_ptr, count, T());
+    else
+      for (size_type i = 0; i < count; i++)
+        std::allocator_traits<Allocator>::construct(_alloc, _ptr + i);
+    report_memory();
+    trace(op_trace::Op::Create, sizeof(T), _size);
   }
 
   template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
@@ -58,8 +101,11 @@ public:
       _capacity(_size),
       _alloc(alloc),
       _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
-    for (auto it = first; it != last; it++)
-      std::allocator_traits<Allocator>::construct(_alloc, _ptr + (it - first), *it);
+    pointer dst = _ptr;
+    for (; first != last; ++first)
+      std::allocator_traits<Allocator>::construct(_alloc, dst++, *first);
+    report_memory();
+    trace(op_trace::Op::Create, sizeof(T), _size);
   }
 
   Vector(const Vector& other)
@@ -67,41 +113,94 @@ public:
       _capacity(other._capacity), 
       _alloc(other._alloc),
       _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
-    for (size_type i = 0; i < other._size; i++)
-      std::allocator_traits<Allocator>::construct(_alloc, _ptr + i, other[i]);
+    copy_elements(_ptr, other._ptr, other._size);
+    report_memory();
+    trace(op_trace::Op::Create, sizeof(T), _size);
   }
 
-  Vector(const Vector& other, const Allocator& )
+  Vector(const Vector& other, const Allocator& alloc)
     : _size(other._size),
       _capacity(other._capacity),
       _alloc(alloc),
       _ptr(std::allocator_traits<Allocator>::allocate(_alloc, _capacity)) {
-    for (size_type i = 0; i < other._size; i++)
-      std::allocator_traits<Allocator>::construct(_alloc, _ptr + i, other[i]);
+    copy_elements(_ptr, other._ptr, other._size);
+    report_memory();
+    trace(op_trace::Op::Create, sizeof(T), _size);
   }
 
-  Vector(const Vector&& other) noexcept
+  Vector(Vector&& other) noexcept
     : _size(other._size),
       _capacity(other._capacity),
       _alloc(other._alloc),
-      _ptr(other._ptr) {}
+      _ptr(other._ptr) {
+    _account.swap(other._account);
+    other.release();
+    if (op_trace::enabled()) {
+      op_trace::record(this, op_trace::Op::Create, sizeof(T), 0, 0, 0);
+      trace(op_trace::Op::MoveFrom, reinterpret_cast<std::uintptr_t>(&other));
+    }
+  }
 
-  Vector(const Vector&& other, const Allocator& alloc) noexcept
+  Vector(Vector&& other, const Allocator& alloc) noexcept
     : _size(other._size),
       _capacity(other._capacity),
       _alloc(alloc),
-      _ptr(other._ptr) {}
+      _ptr(other._ptr) {
+    _account.swap(other._account);
+    other.release();
+    if (op_trace::enabled()) {
+      op_trace::record(this, op_trace::Op::Create, sizeof(T), 0, 0, 0);
+      trace(op_trace::Op::MoveFrom, reinterpret_cast<std::uintptr_t>(&other));
+    }
+  }
 
   Vector(std::initializer_list<T> init, const Allocator& alloc = Allocator())
     : Vector(init.begin(), init.end(), alloc) {}
 
+  template<std::ranges::input_range R>
+  Vector(from_range_t, R&& range, const Allocator& alloc = Allocator())
+    : Vector(alloc) {
+    append_range(std::forward<R>(range));
+  }
+
+  template<class Expr, class = typename std::enable_if<is_vector_expression<Expr>::value>::type>
+  Vector(const Expr& expr, const Allocator& alloc = Allocator())
+    : Vector(alloc) {
+    operator=(expr);
+  }
+
+  //Profiles the call site and reserves what earlier Vectors from it needed
+  explicit Vector(capacity_profile::Tag tag, const Allocator& alloc = Allocator())
+    : Vector(alloc) {
+    _profile.attach(tag.site);
+    if (tag.site)
+      reserve(tag.site->suggested_capacity());
+  }
+
+  ~Vector() {
+    _profile.finish(_size);
+    clear();
+    _account.release();
+    trace(op_trace::Op::Destroy);
+    std::allocator_traits<Allocator>::deallocate(_alloc, _ptr, _capacity);
+  }
+
   //operator= and assign
   Vector& operator=(const Vector& other) {
+    if (this == &other)
+      return *this;
     clear();
+    if (other._size > _capacity) {
+      std::allocator_traits<Allocator>::deallocate(_alloc, _ptr, _capacity);
+      _ptr = nullptr;
+      _capacity = 0;
+      _ptr = std::allocator_traits<Allocator>::allocate(_alloc, other._size);
+      _capacity = other._size;
+    }
+    copy_elements(_ptr, other._ptr, other._size);
     _size = other._size;
-    _capacity = other._capacity;
-    _alloc = other._alloc;
-    _ptr = other._ptr;
+    report_memory();
+    trace(op_trace::Op::CopyFrom, reinterpret_cast<std::uintptr_t>(&other));
     return *this;
   }
 
@@ -115,20 +214,42 @@ public:
     return operator=(Vector(ilist));
   }
 
+  //Evaluates the whole expression in one pass straight into this buffer
+  template<class Expr, class = typename std::enable_if<is_vector_expression<Expr>::value>::type>
+  Vector& operator=(const Expr& expr) {
+    static_assert(std::is_arithmetic<T>::value, "Vector expressions need an arithmetic value type");
+    size_type count = expr.size();
+    if (count > _capacity) {
+      clear();
+      reallocate(count);
+    }
+    expr.evaluate_into(_ptr);
+    _size = count;
+    report_memory();
+    trace(op_trace::Op::Resize, 0, count);
+    return *this;
+  }
+
   void assign(size_type count, const T& value) {
     clear();
-    insert(begin(), count, value);
+    insert(cbegin(), count, value);
   }
 
   template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
   void assign(InputIt first, InputIt last) {
     clear();
-    insert(begin(), first, last);
+    insert(cbegin(), first, last);
   }
   
   void assign(std::initializer_list<T> ilist) {
     clear();
-    insert(begin(), ilist);
+    insert(cbegin(), ilist);
+  }
+
+  template<std::ranges::input_range R>
+  void assign_range(R&& range) {
+    clear();
+    append_range(std::forward<R>(range));
   }
 
   allocator_type getAllocator() const {
@@ -180,14 +301,16 @@ public:
 
   //Iterators
   iterator begin() noexcept {
+    trace(op_trace::Op::Begin);
     return iterator(_ptr);
   }
 
   const_iterator begin() const noexcept {
-    return iterator(_ptr);
+    trace(op_trace::Op::Begin);
+    return const_iterator(_ptr);
   }
 
-  const_iterator cbegin() noexcept {
+  const_iterator cbegin() const noexcept {
     return const_iterator(_ptr);
   }
 
@@ -196,35 +319,35 @@ public:
   }
 
   const_iterator end() const noexcept {
-    return iterator(_ptr + _size);
+    return const_iterator(_ptr + _size);
   }
 
-  const_iterator cend() noexcept {
+  const_iterator cend() const noexcept {
     return const_iterator(_ptr + _size);
   }
 
   reverse_iterator rbegin() noexcept {
-    return reverse_iterator(_ptr + _size);
+    return reverse_iterator(end());
   }
 
   const_reverse_iterator rbegin() const noexcept {
-    return const_reverse_iterator(_ptr + _size);
+    return const_reverse_iterator(end());
   }
 
-  const_reverse_iterator crbegin() noexcept {
-    return const_reverse_iterator(_ptr + _size);
+  const_reverse_iterator crbegin() const noexcept {
+    return const_reverse_iterator(end());
   }
 
   reverse_iterator rend() noexcept {
-    return reverse_iterator(_ptr);
+    return reverse_iterator(begin());
   }
 
   const_reverse_iterator rend() const noexcept {
-    return const_reverse_iterator(_ptr);
+    return const_reverse_iterator(begin());
   }
 
-  const_reverse_iterator crend() noexcept {
-    return const_reverse_iterator(_ptr);
+  const_reverse_iterator crend() const noexcept {
+    return const_reverse_iterator(begin());
   }
 
   //Capacity
@@ -241,8 +364,10 @@ public:
   }
 
   void reserve(size_type new_cap) {
-    if (new_cap <= _capacity)
+    if (new_cap <= _capacity) {
+      trace(op_trace::Op::Reserve, 0, new_cap);
       return;
+    }
 
     try {
       reallocate(new_cap);
@@ -250,6 +375,7 @@ public:
     catch (std::exception&) {
       throw;
     }
+    trace(op_trace::Op::Reserve, 0, new_cap);
   }
 
   size_type capacity() const noexcept {
@@ -263,84 +389,119 @@ public:
     catch (std::exception& ex) {
       throw ex;
     }
+    trace(op_trace::Op::ShrinkToFit);
   }
 
   //Modifiers
   void clear() noexcept {
-    for (auto it = begin(); it != end(); it++)
-      std::allocator_traits<Allocator>::destroy(_alloc, _ptr + (it - begin()));
+    note_peak();
+    destroy_elements(_ptr, _ptr + _size);
     _size = 0;
+    report_memory();
+    trace(op_trace::Op::Clear);
   }
 
   iterator insert(const_iterator pos, const T& value) {
-    return insert(pos, 1, value);
+    return emplace(pos, value);
   }
 
   iterator insert(const_iterator pos, T&& value) {
-    return insert(pos, value);
+    return emplace(pos, std::move(value));
   }
 
   iterator insert(const_iterator pos, size_type count, const T& value) {
-    size_type new_size = _size + count;
-    size_type index = pos - begin();
-    if (new_size > _capacity)
-      reallocate(new_size);
-    auto insert_iter = begin() + index;
-    std::copy_backward(insert_iter, end(), begin() + new_size);
-    std::fill(insert_iter, insert_iter + count, value);
-
-    _capacity = new_size;
-    _size = new_size;
-    return insert_iter;
+    size_type index = pos - cbegin();
+    if (!count)
+      return iterator(_ptr + index);
+    T copy(value);
+    pointer gap = open_gap(index, count);
+    if constexpr (trivially_filled) {
+      fill_elements(gap, count, copy);
+      _size += count;
+      report_memory();
+    }
+    else {
+      fill_gap(index, count, [&](pointer slot) {
+        std::allocator_traits<Allocator>::construct(_alloc, slot, copy);
+      });
+    }
+    trace(op_trace::Op::Insert, index, count);
+    return iterator(_ptr + index);
   }
 
-  template< class InputIt >
-  void insert(const_iterator pos, InputIt first, InputIt last) {
-    size_type new_size = _size + last - first;
-    size_type index = pos - begin();
-    if (new_size > _capacity)
-      reallocate(new_size);
-    auto insert_iter = begin() + index;
-    std::copy_backward(insert_iter, end(), begin() + new_size);
-    std::copy(first, last, insert_iter);
-
-    _capacity = new_size;
-    _size = new_size;
+  template<class InputIt, class = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+  iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    return insert_range(pos, std::ranges::subrange(first, last));
   }
 
   iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
-    insert(pos, ilist.begin(), ilist.end());
-    return pos;
+    return insert_range(pos, ilist);
+  }
+
+  //Sized and forward ranges allocate once. Single pass ranges are appended
+  //with geometric growth and rotated into place.
+  template<std::ranges::input_range R>
+  iterator insert_range(const_iterator pos, R&& range) {
+    size_type index = pos - cbegin();
+    if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>) {
+      size_type count = static_cast<size_type>(std::ranges::distance(range));
+      if (!count)
+        return iterator(_ptr + index);
+      open_gap(index, count);
+      auto it = std::ranges::begin(range);
+      fill_gap(index, count, [&](pointer slot) {
+        std::allocator_traits<Allocator>::construct(_alloc, slot, *it);
+        ++it;
+      });
+      trace(op_trace::Op::Insert, index, count);
+    }
+    else {
+      size_type old_size = _size;
+      append_elements(std::forward<R>(range));
+      std::rotate(_ptr + index, _ptr + old_size, _ptr + _size);
+      trace(op_trace::Op::Insert, index, _size - old_size);
+    }
+    return iterator(_ptr + index);
   }
 
   template<class... Args>
   iterator emplace(const_iterator pos, Args&&... args) {
-    size_type index = pos - begin();
-
-    size_type new_size = _size + 1;
-    reallocate(new_size);
+    size_type index = pos - cbegin();
+    if constexpr (!GrowsInPlace<Allocator>) {
+      if (_size == _capacity) {
+        reallocate_emplace(index, std::forward<Args>(args)...);
+        trace(op_trace::Op::Insert, index, 1);
+        return iterator(_ptr + index);
+      }
+    }
 
-    auto iter = begin() + index;
-    for (size_t i = _size; i >= index; i--)
-      _ptr[i] = _ptr[i - 1];
-    _alloc.construct(&*iter, std::forward<Args>(args)...);
-    _size++;
-    return iter;
+    //Built first, args may refer to elements the gap moves
+    T value(std::forward<Args>(args)...);
+    open_gap(index, 1);
+    fill_gap(index, 1, [&](pointer slot) {
+      std::allocator_traits<Allocator>::construct(_alloc, slot, std::move(value));
+    });
+    trace(op_trace::Op::Insert, index, 1);
+    return iterator(_ptr + index);
   }
 
   iterator erase(const_iterator pos) {
-    std::allocator_traits<Allocator>::destroy(_alloc, &*pos);
-    std::copy(pos + 1, end(), pos);
-    _size--;
-    return pos;
+    return erase(pos, pos + 1);
   }
 
+  //Moves the tail down over the erased range, then destroys the leftover tail slots
   iterator erase(const_iterator first, const_iterator last) {
-    for (auto it = first; it != last; it++)
-      std::allocator_traits<Allocator>::destroy(_alloc, &*it);
-    std::copy(last, end(), first);
-    _size -= std::distance(first, last);
-    return first;
+    note_peak();
+    size_type index = first - cbegin();
+    size_type count = last - first;
+    if (!count)
+      return iterator(_ptr + index);
+    pointer new_end = std::move(_ptr + index + count, _ptr + _size, _ptr + index);
+    destroy_elements(new_end, _ptr + _size);
+    _size -= count;
+    report_memory();
+    trace(op_trace::Op::Erase, index, count);
+    return iterator(_ptr + index);
   }
 
   void push_back(const T& value) {
@@ -354,19 +515,43 @@ public:
   template<class... Args>
   void emplace_back(Args&&... args) {
     size_type new_size = _size + 1;
-    if (new_size > _capacity)
-      reallocate(new_size);
-    std::allocator_traits<Allocator>::construct(
-      _alloc,
-      _ptr + _size,
-      std::forward<Args>(args)...
-    );
+    if (new_size > _capacity) {
+      //args may refer to an element of the buffer being freed
+      if constexpr (GrowsInPlace<Allocator>) {
+        T value(std::forward<Args>(args)...);
+        reallocate(grown_capacity(new_size));
+        std::allocator_traits<Allocator>::construct(_alloc, _ptr + _size, std::move(value));
+        _size = new_size;
+      }
+      else {
+        reallocate_emplace(_size, std::forward<Args>(args)...);
+      }
+    }
+    else {
+      std::allocator_traits<Allocator>::construct(
+        _alloc,
+        _ptr + _size,
+        std::forward<Args>(args)...
+      );
+      _size = new_size;
+    }
+    report_memory();
+    trace(op_trace::Op::PushBack);
+  }
 
-    _size = new_size;
+  template<std::ranges::input_range R>
+  void append_range(R&& range) {
+    size_type old_size = _size;
+    append_elements(std::forward<R>(range));
+    trace(op_trace::Op::Insert, old_size, _size - old_size);
   }
 
   void pop_back() {
-    erase(begin() + _size - 1);
+    note_peak();
+    destroy_elements(_ptr + _size - 1, _ptr + _size);
+    _size--;
+    report_memory();
+    trace(op_trace::Op::PopBack);
   }
 
   void resize(size_type count) {
@@ -374,48 +559,296 @@ public:
   }
 
   void resize(size_type count, const value_type& value) {
+    note_peak();
     if (count < _size)
-      for (auto it = begin() + count; it != end(); it++)
-        std::allocator_traits<Allocator>::destroy(_alloc, &*it);
+      destroy_elements(_ptr + count, _ptr + _size);
     else if (count > _size) {
-      reallocate(count);
-      for (auto it = end(); it != end() + count - _size; it++)
-        std::allocator_traits<Allocator>::construct(
-          _alloc, 
-          _ptr + _size + (it - end()),
-          value
-        );
+      if (count > _capacity) {
+        //value may be an element of the buffer being freed
+        T copy(value);
+        reallocate(count);
+        fill_elements(_ptr + _size, count - _size, copy);
+      }
+      else {
+        fill_elements(_ptr + _size, count - _size, value);
+      }
     }
     _size = count;
+    report_memory();
+    trace(op_trace::Op::Resize, 0, count);
+  }
+
+  //Reports this Vector under tag in the memory registry. tag must outlive the Vector.
+  void memory_tag(const char* tag) noexcept {
+    _account.retag<T>(tag, _size, _capacity);
   }
 
   void swap(Vector& other) noexcept {
+    note_peak();
+    other.note_peak();
     std::swap(this->_size, other._size);
     std::swap(this->_capacity, other._capacity);
     std::swap(this->_ptr, other._ptr);
     std::swap(this->_alloc, other._alloc);
+    _account.swap(other._account);
+    trace(op_trace::Op::Swap, reinterpret_cast<std::uintptr_t>(&other));
   }
 
 private:
+  template<class, class>
+  friend class VectorBuilder;
+
+  template<std::ranges::input_range R>
+  void append_elements(R&& range) {
+    if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>) {
+      size_type count = static_cast<size_type>(std::ranges::distance(range));
+      if (_size + count > _capacity)
+        reallocate(grown_capacity(_size + count));
+      for (auto&& value : range)
+        std::allocator_traits<Allocator>::construct(_alloc, _ptr + _size++, std::forward<decltype(value)>(value));
+    }
+    else {
+      for (auto&& value : range) {
+        if (_size == _capacity)
+          reallocate(grown_capacity(_size + 1));
+        std::allocator_traits<Allocator>::construct(_alloc, _ptr + _size++, std::forward<decltype(value)>(value));
+      }
+    }
+    report_memory();
+  }
+
+  //Element lifetimes that need no code, so the per-element construct and destroy loops
+  //are dropped or become bulk copies and fills. Allocators with their own construct or
+  //destroy keep the loops.
+  static constexpr bool trivially_destroyed = std::is_trivially_destructible<T>::value
+    && !requires(Allocator& alloc, T* ptr) { alloc.destroy(ptr); };
+  static constexpr bool trivially_filled = std::is_trivially_copyable<T>::value
+    && !requires(Allocator& alloc, T* ptr, const T& value) { alloc.construct(ptr, value); };
+
+  //Builds the new element straight in the new buffer, then moves the old elements around it
+  template<class... Args>
+  void reallocate_emplace(size_type index, Args&&... args) {
+    size_type new_cap = grown_capacity(_size + 1);
+    if (new_cap > max_size())
+      throw std::length_error("New capacity over limit");
+    pointer new_ptr = std::allocator_traits<Allocator>::allocate(_alloc, new_cap);
+    try {
+      std::allocator_traits<Allocator>::construct(_alloc, new_ptr + index, std::forward<Args>(args)...);
+    }
+    catch (...) {
+      std::allocator_traits<Allocator>::deallocate(_alloc, new_ptr, new_cap);
+      throw;
+    }
+    try {
+      relocate_around(index, 1, new_ptr);
+    }
+    catch (...) {
+      destroy_elements(new_ptr + index, new_ptr + index + 1);
+      std::allocator_traits<Allocator>::deallocate(_alloc, new_ptr, new_cap);
+      throw;
+    }
+
+    _capacity = new_cap;
+    _size++;
+    _ptr = new_ptr;
+    report_memory();
+  }
+
   void reallocate(size_type new_cap) {
     if (new_cap > max_size())
       throw std::length_error("New capacity over limit");
+    if constexpr (GrowsInPlace<Allocator>) {
+      if (pointer moved = _alloc.resize_allocation(_ptr, _capacity, new_cap)) {
+        _capacity = new_cap;
+        _ptr = moved;
+        report_memory();
+        return;
+      }
+    }
     pointer new_ptr = std::allocator_traits<Allocator>::allocate(_alloc, new_cap);
-    for (auto it = begin(); it != end(); it++)
+    try {
+      relocate_around(_size, 0, new_ptr);
+    }
+    catch (...) {
+      std::allocator_traits<Allocator>::deallocate(_alloc, new_ptr, new_cap);
+      throw;
+    }
+
+    _capacity = new_cap;
+    _ptr = new_ptr;
+    report_memory();
+  }
+
+  //Moves the elements into new_ptr with count raw slots left at index, then frees the
+  //old buffer. Elements that may throw on move are copied; if a copy throws, the copies
+  //made so far are destroyed and the Vector is unchanged.
+  void relocate_around(size_type index, size_type count, pointer new_ptr) {
+    if constexpr (trivially_filled && trivially_destroyed) {
+      copy_elements(new_ptr, _ptr, index);
+      copy_elements(new_ptr + index + count, _ptr + index, _size - index);
+    }
+    else {
+      size_type built = 0;
+      try {
+        for (; built < _size; built++)
+          std::allocator_traits<Allocator>::construct(
+            _alloc,
+            new_ptr + built + (built < index ? 0 : count),
+            std::move_if_noexcept(_ptr[built])
+          );
+      }
+      catch (...) {
+        destroy_elements(new_ptr, new_ptr + std::min(built, index));
+        if (built > index)
+          destroy_elements(new_ptr + index + count, new_ptr + built + count);
+        throw;
+      }
+      destroy_elements(_ptr, _ptr + _size);
+    }
+    if (_ptr)
+      std::allocator_traits<Allocator>::deallocate(_alloc, _ptr, _capacity);
+  }
+
+  //Leaves count raw slots at index with the tail moved up behind them. The caller
+  //constructs the new elements with fill_gap, which adds count to _size.
+  pointer open_gap(size_type index, size_type count) {
+    if (_size + count > _capacity) {
+      if constexpr (GrowsInPlace<Allocator>) {
+        reallocate(grown_capacity(_size + count));
+      }
+      else {
+        //The tail moves once, straight to its final place in the new buffer
+        size_type new_cap = grown_capacity(_size + count);
+        if (new_cap > max_size())
+          throw std::length_error("New capacity over limit");
+        pointer new_ptr = std::allocator_traits<Allocator>::allocate(_alloc, new_cap);
+        try {
+          relocate_around(index, count, new_ptr);
+        }
+        catch (...) {
+          std::allocator_traits<Allocator>::deallocate(_alloc, new_ptr, new_cap);
+          throw;
+        }
+        _capacity = new_cap;
+        _ptr = new_ptr;
+        report_memory();
+        return _ptr + index;
+      }
+    }
+
+    //Tail elements landing past the end are move-constructed, the rest move-assigned
+    size_type moved_to_raw = std::min(count, _size - index);
+    for (size_type i = 0; i < moved_to_raw; i++)
       std::allocator_traits<Allocator>::construct(
         _alloc,
-        new_ptr + (it - begin()),
-        std::forward<T>(*it)
+        _ptr + _size + count - moved_to_raw + i,
+        std::move(_ptr[_size - moved_to_raw + i])
       );
+    std::move_backward(_ptr + index, _ptr + _size - moved_to_raw, _ptr + _size + count - moved_to_raw);
+    destroy_elements(_ptr + index, _ptr + index + moved_to_raw);
+    return _ptr + index;
+  }
+
+  //Constructs the count elements of a gap left by open_gap, build(slot) makes one. If
+  //one throws, the gap and the tail behind it are destroyed and [0, index) is kept, so
+  //no slot is destroyed twice.
+  template<class Build>
+  void fill_gap(size_type index, size_type count, Build build) {
+    pointer gap = _ptr + index;
+    size_type built = 0;
+    try {
+      for (; built < count; built++)
+        build(gap + built);
+    }
+    catch (...) {
+      note_peak();
+      destroy_elements(gap, gap + built);
+      destroy_elements(gap + count, _ptr + _size + count);
+      _size = index;
+      report_memory();
+      throw;
+    }
+    _size += count;
+    report_memory();
+  }
 
-    _capacity = new_cap;
-    _ptr = new_ptr;
+  //Trivially copyable elements above streaming::threshold() bypass the cache
+  void copy_elements(pointer dst, const T* src, size_type count) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      if (streaming::enabled_for(count * sizeof(T))) {
+        streaming::copy(dst, src, count * sizeof(T));
+        return;
+      }
+    }
+    if constexpr (trivially_filled) {
+      if (count)
+        std::memcpy(static_cast<void*>(dst), src, count * sizeof(T));
+    }
+    else {
+      for (size_type i = 0; i < count; i++)
+        std::allocator_traits<Allocator>::construct(_alloc, dst + i, src[i]);
+    }
+  }
+
+  //One pass of plain stores for trivial types, which compilers turn into memset or SIMD
+  void fill_elements(pointer dst, size_type count, const T& value) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      if (streaming::enabled_for(count * sizeof(T))) {
+        streaming::fill(dst, count, value);
+        return;
+      }
+    }
+    if constexpr (trivially_filled) {
+      T copy(value);
+      std::fill_n(dst, count, copy);
+    }
+    else {
+      for (size_type i = 0; i < count; i++)
+        std::allocator_traits<Allocator>::construct(_alloc, dst + i, value);
+    }
+  }
+
+  void destroy_elements(pointer first, pointer last) noexcept {
+    if constexpr (!trivially_destroyed)
+      for (; first != last; ++first)
+        std::allocator_traits<Allocator>::destroy(_alloc, first);
+  }
+
+  //At least double, so appends and inserts are amortized O(1). Only reserve, resize
+  //and the constructors size the buffer exactly.
+  size_type grown_capacity(size_type min_cap) const {
+    size_type doubled = _capacity > max_size() / 2 ? max_size() : 2 * _capacity;
+    return std::max(min_cap, doubled);
+  }
+
+  //Records the operation when op_trace is started
+  void trace(op_trace::Op op, std::uint64_t position = 0, std::uint64_t count = 0) const noexcept {
+    if (op_trace::enabled())
+      op_trace::record(this, op, position, count, _size, _capacity);
+  }
+
+  void report_memory() noexcept {
+    _account.update<T>(_size, _capacity);
+  }
+
+  //Sizes only drop through the calls that note the peak first
+  void note_peak() noexcept {
+    _profile.note(_size);
+  }
+
+  void release() noexcept {
+    note_peak();
+    _size = 0;
+    _capacity = 0;
+    _ptr = nullptr;
   }
 
   size_type _size;
   size_type _capacity;
   allocator_type _alloc;
   pointer _ptr;
+  VECTOR_NO_UNIQUE_ADDRESS capacity_profile::Tracker _profile;
+  VECTOR_NO_UNIQUE_ADDRESS memory_registry::Account _account;
 };
 
 template <class T, class Allocator>
@@ -0,0 +1,146 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+//Per-thread Vectors that are merged into one. The merge sums the part sizes,
+//allocates the destination once and then copies or moves the parts into their
+//slots on several threads, splitting by element count so large parts don't
+//leave the other threads idle. Element constructors must not throw.
+template<class T, class Allocator>
+class VectorBuilder {
+public:
+  using size_type = std::size_t;
+
+  explicit VectorBuilder(size_type parts = std::thread::hardware_concurrency())
+    : _parts(parts ? parts : 1) {}
+
+  size_type parts() const noexcept {
+    return _parts.size();
+  }
+
+  //Vector filled by one thread only
+  Vector<T, Allocator>& local(size_type part) {
+    return _parts[part].vector;
+  }
+
+  //Moves every local Vector into the result. The locals are left empty with their capacity.
+  Vector<T, Allocator> build(size_type threads = std::thread::hardware_concurrency()) {
+    return concat(_parts.data(), _parts.size(), threads);
+  }
+
+  //Moves out of mutable parts, copies const ones
+  template<class Part>
+  static Vector<T, Allocator> concat(Part* parts, size_type count, size_type threads) {
+    constexpr bool move = !std::is_const<Part>::value;
+    Vector<size_type> offsets(count + 1, 0);
+    for (size_type i = 0; i < count; i++)
+      offsets[i + 1] = offsets[i] + unwrap(parts[i]).size();
+    size_type total = offsets[count];
+
+    Vector<T, Allocator> result;
+    result.reserve(total);
+    T* dst = result.data();
+
+    //Copies elements [first, last) of the concatenation
+    auto copy_span = [&](size_type first, size_type last) {
+      size_type part = std::upper_bound(offsets.begin(), offsets.end(), first) - offsets.begin() - 1;
+      while (first < last) {
+        size_type begin = first - offsets[part];
+        size_type end = std::min(last, offsets[part + 1]) - offsets[part];
+        auto* src = unwrap(parts[part]).data();
+        if constexpr (std::is_trivially_copyable<T>::value) {
+          std::memcpy(dst + first, src + begin, (end - begin) * sizeof(T));
+        }
+        else {
+          for (size_type i = begin; i < end; i++) {
+            if constexpr (move)
+              std::allocator_traits<Allocator>::construct(result._alloc, dst + offsets[part] + i, std::move(src[i]));
+            else
+              std::allocator_traits<Allocator>::construct(result._alloc, dst + offsets[part] + i, src[i]);
+          }
+        }
+        first = offsets[part] + end;
+        part++;
+      }
+    };
+
+    if (!threads)
+      threads = 1;
+    size_type chunk = (total + threads - 1) / threads;
+    if (threads == 1 || total < kMinParallel) {
+      copy_span(0, total);
+    }
+    else {
+      Workers workers;
+      workers.threads.reserve(threads - 1);
+      size_type first = chunk;
+      try {
+        for (; first < total; first += chunk)
+          workers.threads.emplace_back(copy_span, first, std::min(first + chunk, total));
+      }
+      catch (const std::system_error&) {
+        //Out of threads, the spans not handed out are copied below
+      }
+      copy_span(0, std::min(chunk, total));
+      if (first < total)
+        copy_span(first, total);
+    }
+    result._size = total;
+    result.report_memory();
+    result.trace(op_trace::Op::Resize, 0, total);
+
+    if constexpr (move)
+      for (size_type i = 0; i < count; i++)
+        unwrap(parts[i]).clear();
+    return result;
+  }
+
+private:
+  static constexpr size_type kMinParallel = size_type(1) << 15;
+
+  //Joins on scope exit, so an exception never destroys a joinable thread
+  struct Workers {
+    ~Workers() {
+      for (auto& thread : threads)
+        thread.join();
+    }
+
+    Vector<std::thread> threads;
+  };
+
+  //Each local Vector on a cache line of its own, so threads pushing into neighbouring
+  //parts don't keep invalidating each other's size and pointer
+  struct alignas(64) Slot {
+    Vector<T, Allocator> vector;
+  };
+
+  static Vector<T, Allocator>& unwrap(Slot& slot) noexcept {
+    return slot.vector;
+  }
+
+  template<class Part>
+  static Part& unwrap(Part& part) noexcept {
+    return part;
+  }
+
+  Vector<Slot> _parts;
+};
+
+//Concatenates parts into one Vector with a single allocation, moving the elements out
+template<class T, class Allocator>
+Vector<T, Allocator> parallel_concat(Vector<Vector<T, Allocator>>& parts,
+    std::size_t threads = std::thread::hardware_concurrency()) {
+  return VectorBuilder<T, Allocator>::concat(parts.data(), parts.size(), threads);
+}
+
+//Concatenates copies of parts into one Vector with a single allocation
+template<class T, class Allocator>
+Vector<T, Allocator> parallel_concat(const Vector<Vector<T, Allocator>>& parts,
+    std::size_t threads = std::thread::hardware_concurrency()) {
+  return VectorBuilder<T, Allocator>::concat(parts.data(), parts.size(), threads);
+}
@@ -0,0 +1,409 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+//Lazy element-wise arithmetic over Vector of arithmetic types. Operators build
+//expression nodes that hold operands by reference (Vector) or by value (nodes,
+//scalars). Assigning a node to a Vector runs one fused loop over all operands,
+//split across threads once the size reaches parallel_threshold().
+namespace vector_expr {
+
+//parallel_for starts fresh threads on every call, tens of microseconds each, so a split
+//only pays once the loop itself runs for milliseconds: about 4M elements of simple
+//arithmetic. Lower it for expensive expressions, raise it for memory-bound ones.
+constexpr std::size_t kDefaultParallelThreshold = std::size_t(1) << 22;
+
+inline std::atomic<std::size_t>& parallel_threshold_storage() {
+  static std::atomic<std::size_t> threshold(kDefaultParallelThreshold);
+  return threshold;
+}
+
+inline std::size_t parallel_threshold() {
+  return parallel_threshold_storage().load(std::memory_order_relaxed);
+}
+
+//Element count from which evaluation is split across hardware threads
+inline void set_parallel_threshold(std::size_t count) {
+  parallel_threshold_storage().store(count, std::memory_order_relaxed);
+}
+
+//Length of the chunks parallel_for hands to body, count when it runs on one thread
+inline std::size_t parallel_chunk(std::size_t count) {
+  std::size_t workers = std::thread::hardware_concurrency();
+  if (count < parallel_threshold() || workers < 2)
+    return std::max<std::size_t>(count, 1);
+  return (count + workers - 1) / workers;
+}
+
+//Calls body(first, last, index) over [0, count) in chunks of chunk elements, index
+//counting the chunks from 0, on several threads when there is more than one chunk
+template<class Body>
+void parallel_for(std::size_t count, std::size_t chunk, const Body& body) {
+  if (chunk >= count) {
+    body(std::size_t(0), count, std::size_t(0));
+    return;
+  }
+
+  Vector<std::thread> threads;
+  threads.reserve((count - 1) / chunk);
+  try {
+    for (std::size_t first = chunk; first < count; first += chunk)
+      threads.emplace_back([&body, first, chunk, count] {
+        body(first, std::min(first + chunk, count), first / chunk);
+      });
+    body(std::size_t(0), std::min(chunk, count), std::size_t(0));
+  }
+  catch (...) {
+    //Joinable threads must not be destroyed
+    for (auto& thread : threads)
+      thread.join();
+    throw;
+  }
+  for (auto& thread : threads)
+    thread.join();
+}
+
+//Calls body(first, last) over [0, count) in chunks of parallel_chunk(count)
+template<class Body>
+void parallel_for(std::size_t count, const Body& body) {
+  parallel_for(count, parallel_chunk(count), [&body](std::size_t first, std::size_t last, std::size_t) {
+    body(first, last);
+  });
+}
+
+template<class E>
+class Expression {
+public:
+  const E& self() const {
+    return static_cast<const E&>(*this);
+  }
+
+  template<class T>
+  void evaluate_into(T* out) const {
+    const E& expr = self();
+    parallel_for(expr.size(), [&expr, out](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; i++)
+        out[i] = static_cast<T>(expr[i]);
+    });
+  }
+};
+
+template<class T>
+class Terminal : public Expression<Terminal<T>> {
+public:
+  using value_type = T;
+  static constexpr bool is_scalar = false;
+
+  Terminal(const T* data, std::size_t size) : _data(data), _size(size) {}
+
+  T operator[](std::size_t i) const {
+    return _data[i];
+  }
+
+  std::size_t size() const {
+    return _size;
+  }
+
+private:
+  const T* _data;
+  std::size_t _size;
+};
+
+//A scalar broadcast to every position
+template<class T>
+class Scalar : public Expression<Scalar<T>> {
+public:
+  using value_type = T;
+  static constexpr bool is_scalar = true;
+
+  explicit Scalar(T value) : _value(value) {}
+
+  T operator[](std::size_t) const {
+    return _value;
+  }
+
+  std::size_t size() const {
+    return 0;
+  }
+
+private:
+  T _value;
+};
+
+template<class Op, class E>
+class Unary : public Expression<Unary<Op, E>> {
+public:
+  using value_type = decltype(Op::apply(std::declval<typename E::value_type>()));
+  static constexpr bool is_scalar = E::is_scalar;
+
+  explicit Unary(const E& expr) : _expr(expr) {}
+
+  value_type operator[](std::size_t i) const {
+    return Op::apply(_expr[i]);
+  }
+
+  std::size_t size() const {
+    return _expr.size();
+  }
+
+private:
+  E _expr;
+};
+
+template<class Op, class L, class R>
+class Binary : public Expression<Binary<Op, L, R>> {
+public:
+  using value_type = decltype(Op::apply(std::declval<typename L::value_type>(), std::declval<typename R::value_type>()));
+  static constexpr bool is_scalar = L::is_scalar && R::is_scalar;
+
+  Binary(const L& lhs, const R& rhs) : _lhs(lhs), _rhs(rhs) {
+    if (!L::is_scalar && !R::is_scalar && lhs.size() != rhs.size())
+      throw std::length_error("Vector expression operands differ in size");
+  }
+
+  value_type operator[](std::size_t i) const {
+    return Op::apply(_lhs[i], _rhs[i]);
+  }
+
+  std::size_t size() const {
+    return L::is_scalar ? _rhs.size() : _lhs.size();
+  }
+
+private:
+  L _lhs;
+  R _rhs;
+};
+
+template<class A, class B, class C>
+class Fma : public Expression<Fma<A, B, C>> {
+public:
+  using value_type = decltype(std::declval<typename A::value_type>() * std::declval<typename B::value_type>()
+    + std::declval<typename C::value_type>());
+  static constexpr bool is_scalar = A::is_scalar && B::is_scalar && C::is_scalar;
+
+  Fma(const A& a, const B& b, const C& c) : _a(a), _b(b), _c(c) {
+    std::size_t size = this->size();
+    if ((!A::is_scalar && a.size() != size) || (!B::is_scalar && b.size() != size) || (!C::is_scalar && c.size() != size))
+      throw std::length_error("Vector expression operands differ in size");
+  }
+
+  value_type operator[](std::size_t i) const {
+    return _a[i] * _b[i] + _c[i];
+  }
+
+  std::size_t size() const {
+    return !A::is_scalar ? _a.size() : !B::is_scalar ? _b.size() : _c.size();
+  }
+
+private:
+  A _a;
+  B _b;
+  C _c;
+};
+
+struct Plus { template<class X, class Y> static auto apply(X x, Y y) { return x + y; } };
+struct Minus { template<class X, class Y> static auto apply(X x, Y y) { return x - y; } };
+struct Multiplies { template<class X, class Y> static auto apply(X x, Y y) { return x * y; } };
+struct Divides { template<class X, class Y> static auto apply(X x, Y y) { return x / y; } };
+struct Negate { template<class X> static auto apply(X x) { return -x; } };
+struct Less { template<class X, class Y> static bool apply(X x, Y y) { return x < y; } };
+struct Greater { template<class X, class Y> static bool apply(X x, Y y) { return x > y; } };
+struct LessEqual { template<class X, class Y> static bool apply(X x, Y y) { return x <= y; } };
+struct GreaterEqual { template<class X, class Y> static bool apply(X x, Y y) { return x >= y; } };
+struct EqualTo { template<class X, class Y> static bool apply(X x, Y y) { return x == y; } };
+struct NotEqualTo { template<class X, class Y> static bool apply(X x, Y y) { return x != y; } };
+
+//Maps a Vector, expression node or arithmetic scalar to its node type
+template<class X, class = void>
+struct operand {};
+
+template<class T, class Allocator>
+struct operand<Vector<T, Allocator>, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+  using type = Terminal<T>;
+  static type wrap(const Vector<T, Allocator>& vector) {
+    return type(vector.data(), vector.size());
+  }
+};
+
+template<class X>
+struct operand<X, typename std::enable_if<std::is_base_of<Expression<X>, X>::value>::type> {
+  using type = X;
+  static const X& wrap(const X& expr) {
+    return expr;
+  }
+};
+
+template<class X>
+struct operand<X, typename std::enable_if<std::is_arithmetic<X>::value>::type> {
+  using type = Scalar<X>;
+  static type wrap(X value) {
+    return type(value);
+  }
+};
+
+template<class X>
+using operand_t = typename operand<typename std::decay<X>::type>::type;
+
+template<class X>
+auto wrap(const X& x) -> decltype(operand<X>::wrap(x)) {
+  return operand<X>::wrap(x);
+}
+
+template<class X, class = void>
+struct is_operand : std::false_type {};
+
+template<class X>
+struct is_operand<X, typename std::void_t<typename operand<typename std::decay<X>::type>::type>> : std::true_type {};
+
+template<class X>
+struct is_lazy : std::integral_constant<bool, is_operand<X>::value && !std::is_arithmetic<typename std::decay<X>::type>::value> {};
+
+//Enabled when both sides are operands and at least one isn't a plain scalar
+template<class L, class R>
+using enable_binary = typename std::enable_if<is_operand<L>::value && is_operand<R>::value
+  && (is_lazy<L>::value || is_lazy<R>::value)>::type;
+
+template<class Op, class L, class R>
+Binary<Op, operand_t<L>, operand_t<R>> make_binary(const L& lhs, const R& rhs) {
+  return Binary<Op, operand_t<L>, operand_t<R>>(wrap(lhs), wrap(rhs));
+}
+
+//Element-wise comparisons. Vector's own relational operators stay lexicographic.
+template<class L, class R, class = enable_binary<L, R>>
+auto less(const L& lhs, const R& rhs) { return make_binary<Less>(lhs, rhs); }
+
+template<class L, class R, class = enable_binary<L, R>>
+auto greater(const L& lhs, const R& rhs) { return make_binary<Greater>(lhs, rhs); }
+
+template<class L, class R, class = enable_binary<L, R>>
+auto less_equal(const L& lhs, const R& rhs) { return make_binary<LessEqual>(lhs, rhs); }
+
+template<class L, class R, class = enable_binary<L, R>>
+auto greater_equal(const L& lhs, const R& rhs) { return make_binary<GreaterEqual>(lhs, rhs); }
+
+template<class L, class R, class = enable_binary<L, R>>
+auto equal_to(const L& lhs, const R& rhs) { return make_binary<EqualTo>(lhs, rhs); }
+
+template<class L, class R, class = enable_binary<L, R>>
+auto not_equal_to(const L& lhs, const R& rhs) { return make_binary<NotEqualTo>(lhs, rhs); }
+
+//a * b + c in one node
+template<class A, class B, class C,
+  class = typename std::enable_if<is_operand<A>::value && is_operand<B>::value && is_operand<C>::value
+    && (is_lazy<A>::value || is_lazy<B>::value || is_lazy<C>::value)>::type>
+Fma<operand_t<A>, operand_t<B>, operand_t<C>> fma(const A& a, const B& b, const C& c) {
+  return Fma<operand_t<A>, operand_t<B>, operand_t<C>>(wrap(a), wrap(b), wrap(c));
+}
+
+//Reductions. Each thread folds its own chunk, the partial results are folded in chunk
+//order after the join, so floating-point results don't depend on thread timing.
+template<class X, class Fold>
+auto reduce(const X& x, typename operand_t<X>::value_type init, const Fold& fold) {
+  using value_type = typename operand_t<X>::value_type;
+  const auto& expr = wrap(x);
+  std::size_t count = expr.size();
+  if (!count)
+    return init;
+
+  //The chunk length is read once, partial has a slot for every chunk parallel_for makes
+  std::size_t chunk = parallel_chunk(count);
+  std::size_t chunks = (count + chunk - 1) / chunk;
+  Vector<value_type> partial(chunks, init);
+  parallel_for(count, chunk, [&](std::size_t first, std::size_t last, std::size_t index) {
+    value_type acc = init;
+    for (std::size_t i = first; i < last; i++)
+      acc = fold(acc, expr[i]);
+    partial[index] = acc;
+  });
+
+  value_type result = init;
+  for (std::size_t i = 0; i < chunks; i++)
+    result = fold(result, partial[i]);
+  return result;
+}
+
+template<class X, class = typename std::enable_if<is_lazy<X>::value>::type>
+auto sum(const X& x) {
+  using value_type = typename operand_t<X>::value_type;
+  return reduce(x, value_type(0), [](value_type a, value_type b) { return a + b; });
+}
+
+template<class X, class = typename std::enable_if<is_lazy<X>::value>::type>
+auto min(const X& x) {
+  using value_type = typename operand_t<X>::value_type;
+  if (!wrap(x).size())
+    throw std::out_of_range("min of an empty Vector expression");
+  return reduce(x, wrap(x)[0], [](value_type a, value_type b) { return b < a ? b : a; });
+}
+
+template<class X, class = typename std::enable_if<is_lazy<X>::value>::type>
+auto max(const X& x) {
+  using value_type = typename operand_t<X>::value_type;
+  if (!wrap(x).size())
+    throw std::out_of_range("max of an empty Vector expression");
+  return reduce(x, wrap(x)[0], [](value_type a, value_type b) { return a < b ? b : a; });
+}
+
+template<class L, class R, class = enable_binary<L, R>>
+auto dot(const L& lhs, const R& rhs) {
+  return sum(make_binary<Multiplies>(lhs, rhs));
+}
+
+template<class X, class = typename std::enable_if<is_lazy<X>::value>::type>
+bool any(const X& x) {
+  return reduce(x, false, [](bool a, bool b) { return a || b; });
+}
+
+template<class X, class = typename std::enable_if<is_lazy<X>::value>::type>
+bool all(const X& x) {
+  return reduce(x, true, [](bool a, bool b) { return a && b; });
+}
+
+}
+
+template<class E>
+struct is_vector_expression<vector_expr::Terminal<E>> : std::true_type {};
+
+template<class E>
+struct is_vector_expression<vector_expr::Scalar<E>> : std::false_type {};
+
+template<class Op, class E>
+struct is_vector_expression<vector_expr::Unary<Op, E>> : std::true_type {};
+
+template<class Op, class L, class R>
+struct is_vector_expression<vector_expr::Binary<Op, L, R>> : std::true_type {};
+
+template<class A, class B, class C>
+struct is_vector_expression<vector_expr::Fma<A, B, C>> : std::true_type {};
+
+//Arithmetic operators live next to Vector so argument dependent lookup finds them for two Vectors
+template<class L, class R, class = vector_expr::enable_binary<L, R>>
+auto operator+(const L& lhs, const R& rhs) {
+  return vector_expr::make_binary<vector_expr::Plus>(lhs, rhs);
+}
+
+template<class L, class R, class = vector_expr::enable_binary<L, R>>
+auto operator-(const L& lhs, const R& rhs) {
+  return vector_expr::make_binary<vector_expr::Minus>(lhs, rhs);
+}
+
+template<class L, class R, class = vector_expr::enable_binary<L, R>>
+auto operator*(const L& lhs, const R& rhs) {
+  return vector_expr::make_binary<vector_expr::Multiplies>(lhs, rhs);
+}
+
+template<class L, class R, class = vector_expr::enable_binary<L, R>>
+auto operator/(const L& lhs, const R& rhs) {
+  return vector_expr::make_binary<vector_expr::Divides>(lhs, rhs);
+}
+
+template<class X, class = typename std::enable_if<vector_expr::is_lazy<X>::value>::type>
+auto operator-(const X& x) {
+  return vector_expr::Unary<vector_expr::Negate, vector_expr::operand_t<X>>(vector_expr::wrap(x));
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include "vector.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <type_traits>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+//Content hashing for Vector. Elements whose object representation is unique
+//(integers, chars, padding-free aggregates of them) are hashed as one byte buffer
+//with a wyhash-style function, 48 bytes per step. Anything else combines the
+//per-element std::hash values. VectorHash and VectorEqual are transparent, so
+//hash maps keyed by Vector can be searched with a std::span without building a key.
+namespace vector_hash {
+
+inline void multiply(std::uint64_t& lo, std::uint64_t& hi) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = static_cast<unsigned __int128>(lo) * hi;
+  lo = static_cast<std::uint64_t>(product);
+  hi = static_cast<std::uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  lo = _umul128(lo, hi, &hi);
+#else
+  std::uint64_t ha = lo >> 32, hb = hi >> 32, la = static_cast<std::uint32_t>(lo), lb = static_cast<std::uint32_t>(hi);
+  std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+  std::uint64_t carry = t < rl;
+  std::uint64_t low = t + (rm1 << 32);
+  carry += low < t;
+  lo = low;
+  hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+inline std::uint64_t mix(std::uint64_t a, std::uint64_t b) {
+  multiply(a, b);
+  return a ^ b;
+}
+
+inline std::uint64_t read8(const unsigned char* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, 8);
+  return value;
+}
+
+inline std::uint64_t read4(const unsigned char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value;
+}
+
+constexpr std::uint64_t kSecret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+inline std::uint64_t hash_bytes(const void* data, std::size_t length, std::uint64_t seed = 0) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+  std::uint64_t a = 0;
+  std::uint64_t b = 0;
+  if (length <= 16) {
+    if (length >= 4) {
+      a = (read4(p) << 32) | read4(p + ((length >> 3) << 2));
+      b = (read4(p + length - 4) << 32) | read4(p + length - 4 - ((length >> 3) << 2));
+    }
+    else if (length > 0) {
+      a = (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[length >> 1]) << 8) | p[length - 1];
+    }
+  }
+  else {
+    std::size_t left = length;
+    if (left > 48) {
+      std::uint64_t lane1 = seed;
+      std::uint64_t lane2 = seed;
+      do {
+        seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+        lane1 = mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ lane1);
+        lane2 = mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ lane2);
+        p += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (left > 16) {
+      seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+      p += 16;
+      left -= 16;
+    }
+    a = read8(p + left - 16);
+    b = read8(p + left - 8);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  multiply(a, b);
+  return mix(a ^ kSecret[0] ^ length, b ^ kSecret[1]);
+}
+
+template<class T>
+constexpr bool hashes_as_bytes = std::has_unique_object_representations_v<T>;
+
+template<class T>
+std::size_t hash_elements(const T* data, std::size_t count) {
+  if constexpr (hashes_as_bytes<T>) {
+    return static_cast<std::size_t>(hash_bytes(data, count * sizeof(T)));
+  }
+  else {
+    std::uint64_t seed = mix(count ^ kSecret[0], kSecret[1]);
+    std::hash<T> hasher;
+    for (std::size_t i = 0; i < count; i++)
+      seed = mix(seed ^ static_cast<std::uint64_t>(hasher(data[i])), kSecret[2]);
+    return static_cast<std::size_t>(seed);
+  }
+}
+
+}
+
+//Vector key that keeps its hash, for maps that rehash or compare often
+template<class T, class Allocator = std::allocator<T>>
+class HashedVector {
+public:
+  explicit HashedVector(Vector<T, Allocator> vector)
+    : _vector(std::move(vector)),
+      _hash(vector_hash::hash_elements(_vector.data(), _vector.size())) {}
+
+  const Vector<T, Allocator>& get() const noexcept {
+    return _vector;
+  }
+
+  std::size_t hash() const noexcept {
+    return _hash;
+  }
+
+  friend bool operator==(const HashedVector& lhs, const HashedVector& rhs) {
+    return lhs._hash == rhs._hash && lhs._vector == rhs._vector;
+  }
+
+private:
+  Vector<T, Allocator> _vector;
+  std::size_t _hash;
+};
+
+template<class T, class Allocator>
+struct std::hash<Vector<T, Allocator>> {
+  std::size_t operator()(const Vector<T, Allocator>& vector) const {
+    return vector_hash::hash_elements(vector.data(), vector.size());
+  }
+};
+
+template<class T, class Allocator>
+struct std::hash<HashedVector<T, Allocator>> {
+  std::size_t operator()(const HashedVector<T, Allocator>& key) const noexcept {
+    return key.hash();
+  }
+};
+
+template<class T>
+struct VectorHash {
+  using is_transparent = void;
+
+  template<class Allocator>
+  std::size_t operator()(const Vector<T, Allocator>& vector) const {
+    return vector_hash::hash_elements(vector.data(), vector.size());
+  }
+
+  template<class Allocator>
+  std::size_t operator()(const HashedVector<T, Allocator>& key) const noexcept {
+    return key.hash();
+  }
+
+  std::size_t operator()(std::span<const T> elements) const {
+    return vector_hash::hash_elements(elements.data(), elements.size());
+  }
+};
+
+template<class T>
+struct VectorEqual {
+  using is_transparent = void;
+
+  template<class Allocator>
+  static std::span<const T> view(const Vector<T, Allocator>& vector) noexcept {
+    return std::span<const T>(vector.data(), vector.size());
+  }
+
+  template<class Allocator>
+  static std::span<const T> view(const HashedVector<T, Allocator>& key) noexcept {
+    return view(key.get());
+  }
+
+  static std::span<const T> view(std::span<const T> elements) noexcept {
+    return elements;
+  }
+
+  template<class L, class R>
+  bool operator()(const L& lhs, const R& rhs) const {
+    std::span<const T> a = view(lhs);
+    std::span<const T> b = view(rhs);
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+  }
+};
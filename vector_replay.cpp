@@ -0,0 +1,268 @@
+//Replays an op_trace capture against Vector and std::vector and reports, for each,
+//the time, the number of allocations and the peak of live heap bytes.
+//
+//  vector_replay trace.bin [repeats]
+//
+//Elements are replaced by trivially copyable blobs of the recorded element size
+//(rounded up to a power of two, at most 256 bytes), so the replay measures the
+//container and not the element constructors. A begin() directly followed by an
+//insert or erase on the same Vector is taken as a position, any other as a full scan.
+//Each thread's buffer reaches the file as a whole, so a multithreaded capture keeps
+//the order within a thread but not across threads, and it is replayed on one thread.
+#include "vector.h"
+#include "op_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct HeapStats {
+  std::uint64_t allocations = 0;
+  std::uint64_t live_bytes = 0;
+  std::uint64_t peak_bytes = 0;
+};
+
+HeapStats& heap_stats() {
+  static HeapStats stats;
+  return stats;
+}
+
+template<class T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template<class U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    HeapStats& stats = heap_stats();
+    if (n) {
+      stats.allocations++;
+      stats.live_bytes += n * sizeof(T);
+      stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    heap_stats().live_bytes -= n * sizeof(T);
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  friend bool operator==(const CountingAllocator&, const CountingAllocator&) {
+    return true;
+  }
+};
+
+template<std::size_t N>
+struct Blob {
+  unsigned char bytes[N];
+};
+
+volatile unsigned char scan_sink;
+
+//One replayed container, behind a virtual interface so Vectors of different
+//element sizes share one replay loop
+struct Replayed {
+  virtual ~Replayed() = default;
+  virtual void apply(const op_trace::Record& record) = 0;
+  virtual void scan() = 0;
+  virtual void copy_from(Replayed& other) = 0;
+  virtual void move_from(Replayed& other) = 0;
+  virtual void swap_with(Replayed& other) = 0;
+};
+
+template<template<class, class> class Container, std::size_t N>
+struct ReplayedContainer : Replayed {
+  using Element = Blob<N>;
+  using Storage = Container<Element, CountingAllocator<Element>>;
+
+  explicit ReplayedContainer(std::size_t count) : storage(count) {}
+
+  void apply(const op_trace::Record& record) override {
+    std::size_t size = storage.size();
+    std::size_t position = std::min<std::size_t>(record.position, size);
+    switch (record.op) {
+    case op_trace::Op::PushBack:
+      storage.push_back(Element());
+      break;
+    case op_trace::Op::PopBack:
+      if (size)
+        storage.pop_back();
+      break;
+    case op_trace::Op::Insert:
+      storage.insert(storage.begin() + position, record.count, Element());
+      break;
+    case op_trace::Op::Erase:
+      storage.erase(storage.begin() + position, storage.begin() + std::min<std::size_t>(size, position + record.count));
+      break;
+    case op_trace::Op::Reserve:
+      storage.reserve(record.count);
+      break;
+    case op_trace::Op::Resize:
+      storage.resize(record.count);
+      break;
+    case op_trace::Op::ShrinkToFit:
+      storage.shrink_to_fit();
+      break;
+    case op_trace::Op::Clear:
+      storage.clear();
+      break;
+    default:
+      break;
+    }
+  }
+
+  void scan() override {
+    unsigned char sum = 0;
+    for (const Element& element : storage)
+      sum += element.bytes[0];
+    scan_sink = sum;
+  }
+
+  void copy_from(Replayed& other) override {
+    if (auto* same = dynamic_cast<ReplayedContainer*>(&other))
+      storage = same->storage;
+  }
+
+  void move_from(Replayed& other) override {
+    if (auto* same = dynamic_cast<ReplayedContainer*>(&other))
+      storage = std::move(same->storage);
+  }
+
+  void swap_with(Replayed& other) override {
+    if (auto* same = dynamic_cast<ReplayedContainer*>(&other))
+      storage.swap(same->storage);
+  }
+
+  Storage storage;
+};
+
+template<template<class, class> class Container>
+std::unique_ptr<Replayed> make_container(std::uint64_t element_size, std::size_t count) {
+  if (element_size <= 1)
+    return std::make_unique<ReplayedContainer<Container, 1>>(count);
+  if (element_size <= 2)
+    return std::make_unique<ReplayedContainer<Container, 2>>(count);
+  if (element_size <= 4)
+    return std::make_unique<ReplayedContainer<Container, 4>>(count);
+  if (element_size <= 8)
+    return std::make_unique<ReplayedContainer<Container, 8>>(count);
+  if (element_size <= 16)
+    return std::make_unique<ReplayedContainer<Container, 16>>(count);
+  if (element_size <= 32)
+    return std::make_unique<ReplayedContainer<Container, 32>>(count);
+  if (element_size <= 64)
+    return std::make_unique<ReplayedContainer<Container, 64>>(count);
+  if (element_size <= 128)
+    return std::make_unique<ReplayedContainer<Container, 128>>(count);
+  return std::make_unique<ReplayedContainer<Container, 256>>(count);
+}
+
+struct Live {
+  std::unique_ptr<Replayed> container;
+  bool pending_scan = false;
+};
+
+template<template<class, class> class Container>
+void replay(const std::vector<op_trace::Record>& records) {
+  std::unordered_map<std::uint64_t, Live> live;
+  for (const op_trace::Record& record : records) {
+    if (record.op == op_trace::Op::Create) {
+      live[record.id] = Live{ make_container<Container>(record.position, record.count) };
+      continue;
+    }
+    auto it = live.find(record.id);
+    if (it == live.end())
+      continue;
+    Live& target = it->second;
+
+    if (target.pending_scan) {
+      target.pending_scan = false;
+      if (record.op != op_trace::Op::Insert && record.op != op_trace::Op::Erase)
+        target.container->scan();
+    }
+
+    switch (record.op) {
+    case op_trace::Op::Destroy:
+      live.erase(it);
+      break;
+    case op_trace::Op::Begin:
+      target.pending_scan = true;
+      break;
+    case op_trace::Op::Swap:
+    case op_trace::Op::CopyFrom:
+    case op_trace::Op::MoveFrom: {
+      auto other = live.find(record.position);
+      if (other == live.end())
+        break;
+      if (record.op == op_trace::Op::Swap)
+        target.container->swap_with(*other->second.container);
+      else if (record.op == op_trace::Op::CopyFrom)
+        target.container->copy_from(*other->second.container);
+      else
+        target.container->move_from(*other->second.container);
+      break;
+    }
+    default:
+      target.container->apply(record);
+      break;
+    }
+  }
+  for (auto& [id, target] : live)
+    if (target.pending_scan)
+      target.container->scan();
+}
+
+template<class T, class Allocator>
+using StdVector = std::vector<T, Allocator>;
+
+template<template<class, class> class Container>
+void measure(const char* name, const std::vector<op_trace::Record>& records, int repeats) {
+  double best = 0;
+  HeapStats stats;
+  for (int i = 0; i < repeats; i++) {
+    heap_stats() = HeapStats();
+    auto start = std::chrono::steady_clock::now();
+    replay<Container>(records);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!i || elapsed < best)
+      best = elapsed;
+    stats = heap_stats();
+  }
+  std::printf("%-12s %12.3f %14llu %16llu\n", name, best,
+    static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.peak_bytes));
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s trace.bin [repeats]\n", argv[0]);
+    return 2;
+  }
+  int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+  op_trace::Reader reader(argv[1]);
+  if (!reader.valid()) {
+    std::fprintf(stderr, "%s is not a Vector trace\n", argv[1]);
+    return 1;
+  }
+  std::vector<op_trace::Record> records;
+  op_trace::Record record;
+  while (reader.next(record))
+    records.push_back(record);
+
+  std::printf("%zu operations, best of %d runs\n", records.size(), repeats);
+  std::printf("%-12s %12s %14s %16s\n", "container", "time ms", "allocations", "peak bytes");
+  measure<Vector>("Vector", records, repeats);
+  measure<StdVector>("std::vector", records, repeats);
+  return 0;
+}
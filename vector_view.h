@@ -0,0 +1,386 @@
+#pragma once
+#include "vector.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+//Non-owning multi-dimensional views over Vector storage, in the spirit of std::mdspan.
+//A layout maps an index tuple to an offset into data(). StridedLayout covers row-major,
+//column-major and any sub-block of them; TiledLayout stores a matrix as row-major
+//tiles so a tile is contiguous. The kernels in namespace vector_view walk 2-D views in
+//square blocks that fit in L1, so a transpose or a copy between layouts touches each
+//cache line of source and destination once.
+
+//Offset = sum of index * stride over every dimension
+template<std::size_t Rank>
+class StridedLayout {
+  static_assert(Rank > 0, "StridedLayout needs at least one dimension");
+
+public:
+  using size_type = std::size_t;
+  using extents_type = std::array<size_type, Rank>;
+
+  static constexpr size_type rank = Rank;
+
+  StridedLayout() noexcept : _extents{}, _strides{} {}
+  StridedLayout(const extents_type& extents, const extents_type& strides) noexcept
+    : _extents(extents), _strides(strides) {}
+
+  //Last index contiguous, as in C arrays
+  static StridedLayout row_major(const extents_type& extents) noexcept {
+    extents_type strides;
+    size_type stride = 1;
+    for (size_type r = Rank; r-- > 0;) {
+      strides[r] = stride;
+      stride *= extents[r];
+    }
+    return StridedLayout(extents, strides);
+  }
+
+  //First index contiguous, as in Fortran or BLAS
+  static StridedLayout column_major(const extents_type& extents) noexcept {
+    extents_type strides;
+    size_type stride = 1;
+    for (size_type r = 0; r < Rank; r++) {
+      strides[r] = stride;
+      stride *= extents[r];
+    }
+    return StridedLayout(extents, strides);
+  }
+
+  template<class... Indices>
+  size_type operator()(Indices... indices) const noexcept {
+    static_assert(sizeof...(Indices) == Rank, "Index count must match the view rank");
+    size_type index[] = { static_cast<size_type>(indices)... };
+    size_type offset = 0;
+    for (size_type r = 0; r < Rank; r++)
+      offset += index[r] * _strides[r];
+    return offset;
+  }
+
+  size_type extent(size_type r) const noexcept {
+    return _extents[r];
+  }
+
+  size_type stride(size_type r) const noexcept {
+    return _strides[r];
+  }
+
+  const extents_type& extents() const noexcept {
+    return _extents;
+  }
+
+  size_type size() const noexcept {
+    size_type count = 1;
+    for (size_type e : _extents)
+      count *= e;
+    return count;
+  }
+
+  //Elements of storage the view may touch, one past the largest offset
+  size_type required_size() const noexcept {
+    size_type last = 0;
+    for (size_type r = 0; r < Rank; r++) {
+      if (!_extents[r])
+        return 0;
+      last += (_extents[r] - 1) * _strides[r];
+    }
+    return last + 1;
+  }
+
+  //True when the elements fill required_size() without holes
+  bool is_contiguous() const noexcept {
+    return required_size() == size();
+  }
+
+  bool is_row_major() const noexcept {
+    return _strides == row_major(_extents)._strides;
+  }
+
+  bool is_column_major() const noexcept {
+    return _strides == column_major(_extents)._strides;
+  }
+
+  //Same strides over a smaller box, the caller offsets the data pointer
+  StridedLayout sublayout(const extents_type& extents) const noexcept {
+    return StridedLayout(extents, _strides);
+  }
+
+private:
+  extents_type _extents;
+  extents_type _strides;
+};
+
+//Matrix stored as row-major tiles of tile_rows x tile_cols, each tile row-major.
+//Partial tiles at the edges are padded, see required_size().
+class TiledLayout {
+public:
+  using size_type = std::size_t;
+  using extents_type = std::array<size_type, 2>;
+
+  static constexpr size_type rank = 2;
+
+  TiledLayout() noexcept : _rows(0), _cols(0), _tile_rows(1), _tile_cols(1), _tiles_per_row(0) {}
+  TiledLayout(const extents_type& extents, size_type tile_rows, size_type tile_cols)
+    : _rows(extents[0]), _cols(extents[1]), _tile_rows(tile_rows), _tile_cols(tile_cols) {
+    if (!tile_rows || !tile_cols)
+      throw std::invalid_argument("TiledLayout tile extents must be positive");
+    _tiles_per_row = (_cols + _tile_cols - 1) / _tile_cols;
+  }
+
+  size_type operator()(size_type row, size_type col) const noexcept {
+    size_type tile = (row / _tile_rows) * _tiles_per_row + col / _tile_cols;
+    return tile * _tile_rows * _tile_cols + (row % _tile_rows) * _tile_cols + col % _tile_cols;
+  }
+
+  size_type extent(size_type r) const noexcept {
+    return r ? _cols : _rows;
+  }
+
+  extents_type extents() const noexcept {
+    return { _rows, _cols };
+  }
+
+  size_type tile_rows() const noexcept {
+    return _tile_rows;
+  }
+
+  size_type tile_cols() const noexcept {
+    return _tile_cols;
+  }
+
+  size_type size() const noexcept {
+    return _rows * _cols;
+  }
+
+  size_type required_size() const noexcept {
+    return ((_rows + _tile_rows - 1) / _tile_rows) * _tiles_per_row * _tile_rows * _tile_cols;
+  }
+
+  bool is_contiguous() const noexcept {
+    return required_size() == size();
+  }
+
+private:
+  size_type _rows;
+  size_type _cols;
+  size_type _tile_rows;
+  size_type _tile_cols;
+  size_type _tiles_per_row;
+};
+
+template<class T, class Layout = StridedLayout<2>>
+class VectorView {
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using layout_type = Layout;
+  using size_type = std::size_t;
+  using extents_type = typename Layout::extents_type;
+  using reference = T&;
+  using pointer = T*;
+
+  static constexpr size_type rank = Layout::rank;
+
+  VectorView() noexcept : _data(nullptr) {}
+  VectorView(T* data, const Layout& layout) noexcept : _data(data), _layout(layout) {}
+
+  //Row-major view of the whole Vector
+  template<class Allocator>
+  VectorView(Vector<value_type, Allocator>& vector, const extents_type& extents)
+    : VectorView(vector, Layout::row_major(extents)) {}
+
+  template<class Allocator>
+  VectorView(Vector<value_type, Allocator>& vector, const Layout& layout)
+    : _data(vector.data()), _layout(layout) {
+    if (layout.required_size() > vector.size())
+      throw std::length_error("VectorView extends past the end of the Vector");
+  }
+
+  template<class Allocator, class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+  VectorView(const Vector<value_type, Allocator>& vector, const extents_type& extents)
+    : VectorView(vector, Layout::row_major(extents)) {}
+
+  template<class Allocator, class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+  VectorView(const Vector<value_type, Allocator>& vector, const Layout& layout)
+    : _data(vector.data()), _layout(layout) {
+    if (layout.required_size() > vector.size())
+      throw std::length_error("VectorView extends past the end of the Vector");
+  }
+
+  //Read-only view of a mutable one
+  template<class U, class = std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>>>
+  VectorView(const VectorView<U, Layout>& other) noexcept : _data(other.data()), _layout(other.layout()) {}
+
+  template<class... Indices>
+  reference operator()(Indices... indices) const noexcept {
+    return _data[_layout(indices...)];
+  }
+
+  size_type extent(size_type r) const noexcept {
+    return _layout.extent(r);
+  }
+
+  extents_type extents() const noexcept {
+    return _layout.extents();
+  }
+
+  size_type size() const noexcept {
+    return _layout.size();
+  }
+
+  bool empty() const noexcept {
+    return !size();
+  }
+
+  pointer data() const noexcept {
+    return _data;
+  }
+
+  const Layout& layout() const noexcept {
+    return _layout;
+  }
+
+  //Sub-block starting at offsets, sharing this view's storage. Strided layouts only.
+  VectorView subview(const extents_type& offsets, const extents_type& extents) const {
+    for (size_type r = 0; r < rank; r++)
+      if (offsets[r] + extents[r] > extent(r))
+        throw std::out_of_range("VectorView subview out of range");
+    size_type offset = 0;
+    for (size_type r = 0; r < rank; r++)
+      offset += offsets[r] * _layout.stride(r);
+    return VectorView(_data + offset, _layout.sublayout(extents));
+  }
+
+  //Row-major matrix as its transpose, by swapping the strides. No element moves.
+  VectorView transposed() const noexcept {
+    static_assert(rank == 2, "transposed() needs a matrix view");
+    return VectorView(_data, Layout({ extent(1), extent(0) }, { _layout.stride(1), _layout.stride(0) }));
+  }
+
+private:
+  T* _data;
+  Layout _layout;
+};
+
+template<class T>
+using MatrixView = VectorView<T, StridedLayout<2>>;
+
+template<class T>
+using TiledView = VectorView<T, TiledLayout>;
+
+namespace vector_view {
+
+//Block edge of the 2-D kernels. Two 64 x 64 blocks of double fill 64 KiB, of float
+//half that, which stays in L1 or the nearest L2 on current cores.
+constexpr std::size_t kBlock = 64;
+
+template<class Dst, class Src>
+void check_extents(const Dst& dst, const Src& src) {
+  if (dst.extents() != src.extents())
+    throw std::invalid_argument("VectorView extents differ");
+}
+
+//Calls body(row, col) over a rows x cols matrix, one kBlock square at a time.
+//Inside a block the walk follows the fast axis of the destination.
+template<class Body>
+void for_each_blocked(std::size_t rows, std::size_t cols, bool row_inner, const Body& body) {
+  for (std::size_t r0 = 0; r0 < rows; r0 += kBlock) {
+    std::size_t r1 = std::min(rows, r0 + kBlock);
+    for (std::size_t c0 = 0; c0 < cols; c0 += kBlock) {
+      std::size_t c1 = std::min(cols, c0 + kBlock);
+      if (row_inner) {
+        for (std::size_t r = r0; r < r1; r++)
+          for (std::size_t c = c0; c < c1; c++)
+            body(r, c);
+      }
+      else {
+        for (std::size_t c = c0; c < c1; c++)
+          for (std::size_t r = r0; r < r1; r++)
+            body(r, c);
+      }
+    }
+  }
+}
+
+template<class Layout>
+bool columns_inner(const Layout& layout) {
+  if constexpr (std::is_same_v<Layout, TiledLayout>)
+    return true;
+  else
+    return layout.stride(1) <= layout.stride(0);
+}
+
+template<class Layout>
+bool rows_contiguous(const Layout& layout) {
+  if constexpr (std::is_same_v<Layout, TiledLayout>)
+    return false;
+  else
+    return layout.stride(1) == 1;
+}
+
+//dst(i, j) = src(i, j) for views of any layouts with equal extents
+template<class T, class U, class DstLayout, class SrcLayout>
+void copy(const VectorView<T, DstLayout>& dst, const VectorView<U, SrcLayout>& src) {
+  static_assert(DstLayout::rank == 2 && SrcLayout::rank == 2, "copy needs matrix views");
+  check_extents(dst, src);
+  std::size_t rows = dst.extent(0);
+  std::size_t cols = dst.extent(1);
+  if constexpr (std::is_same_v<std::remove_cv_t<U>, T> && std::is_trivially_copyable_v<T>) {
+    if (rows_contiguous(dst.layout()) && rows_contiguous(src.layout())) {
+      for (std::size_t r = 0; r < rows; r++)
+        std::memmove(&dst(r, 0), &src(r, 0), cols * sizeof(T));
+      return;
+    }
+  }
+  for_each_blocked(rows, cols, columns_inner(dst.layout()), [&](std::size_t r, std::size_t c) {
+    dst(r, c) = src(r, c);
+  });
+}
+
+//dst(j, i) = src(i, j). dst and src must not overlap.
+template<class T, class U, class DstLayout, class SrcLayout>
+void transpose(const VectorView<T, DstLayout>& dst, const VectorView<U, SrcLayout>& src) {
+  static_assert(DstLayout::rank == 2 && SrcLayout::rank == 2, "transpose needs matrix views");
+  if (dst.extent(0) != src.extent(1) || dst.extent(1) != src.extent(0))
+    throw std::invalid_argument("VectorView extents differ");
+  for_each_blocked(dst.extent(0), dst.extent(1), columns_inner(dst.layout()), [&](std::size_t r, std::size_t c) {
+    dst(r, c) = src(c, r);
+  });
+}
+
+//dst(i, j) = op(src(i, j))
+template<class T, class U, class DstLayout, class SrcLayout, class Op>
+void transform(const VectorView<T, DstLayout>& dst, const VectorView<U, SrcLayout>& src, Op op) {
+  static_assert(DstLayout::rank == 2 && SrcLayout::rank == 2, "transform needs matrix views");
+  check_extents(dst, src);
+  for_each_blocked(dst.extent(0), dst.extent(1), columns_inner(dst.layout()), [&](std::size_t r, std::size_t c) {
+    dst(r, c) = op(src(r, c));
+  });
+}
+
+//dst(i, j) = op(lhs(i, j), rhs(i, j))
+template<class T, class U, class V, class DstLayout, class LhsLayout, class RhsLayout, class Op>
+void transform(const VectorView<T, DstLayout>& dst, const VectorView<U, LhsLayout>& lhs,
+    const VectorView<V, RhsLayout>& rhs, Op op) {
+  static_assert(DstLayout::rank == 2 && LhsLayout::rank == 2 && RhsLayout::rank == 2, "transform needs matrix views");
+  check_extents(dst, lhs);
+  check_extents(dst, rhs);
+  for_each_blocked(dst.extent(0), dst.extent(1), columns_inner(dst.layout()), [&](std::size_t r, std::size_t c) {
+    dst(r, c) = op(lhs(r, c), rhs(r, c));
+  });
+}
+
+//Copies a view into a new row-major Vector
+template<class T, class Layout>
+Vector<std::remove_cv_t<T>> to_vector(const VectorView<T, Layout>& view) {
+  static_assert(Layout::rank == 2, "to_vector needs a matrix view");
+  Vector<std::remove_cv_t<T>> result(view.size());
+  copy(MatrixView<std::remove_cv_t<T>>(result, view.extents()), view);
+  return result;
+}
+
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//Allocator that reserves a large range of address space per allocation and only
+//commits the pages the capacity needs. Vector detects resize_allocation() and grows
+//through it, so growing never copies elements and data() stays put while the
+//reservation lasts. Past the reservation Linux moves the pages with mremap, still
+//without copying; other systems report failure and Vector falls back to copying.
+//Only for trivially copyable T, since elements may be moved as raw pages.
+//The reservation defaults to twice the committed size, so many small Vectors don't
+//eat the address space; pass reservation_bytes to keep data() fixed up to a known size.
+//Empty allocations map nothing and return nullptr.
+template<class T>
+class VirtualMemoryAllocator {
+  static_assert(std::is_trivially_copyable<T>::value, "VirtualMemoryAllocator needs trivially copyable T");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  //0 reserves twice the committed size of each allocation
+  static constexpr size_type kDefaultReservation = 0;
+
+  explicit VirtualMemoryAllocator(size_type reservation_bytes = kDefaultReservation) noexcept
+    : _reservation(reservation_bytes) {}
+
+  template<class U>
+  VirtualMemoryAllocator(const VirtualMemoryAllocator<U>& other) noexcept
+    : _reservation(other.reservation()) {}
+
+  size_type reservation() const noexcept {
+    return _reservation;
+  }
+
+  T* allocate(size_type count) {
+    if (!count)
+      return nullptr;
+    size_type page = page_size();
+    size_type committed = round_up(header_bytes() + bytes_for(count), page);
+    size_type reserved = _reservation ? round_up(_reservation, page) : 2 * committed;
+    if (reserved < committed)
+      reserved = committed;
+
+    char* base = static_cast<char*>(reserve(reserved));
+    if (!base)
+      throw std::bad_alloc();
+    if (!commit(base, committed)) {
+      release(base, reserved);
+      throw std::bad_alloc();
+    }
+
+    Header* header = reinterpret_cast<Header*>(base);
+    header->reserved = reserved;
+    header->committed = committed;
+    return reinterpret_cast<T*>(base + header_bytes());
+  }
+
+  void deallocate(T* ptr, size_type) noexcept {
+    if (!ptr)
+      return;
+    Header* header = header_of(ptr);
+    release(header, header->reserved);
+  }
+
+  //Makes room for count elements at ptr. Returns the buffer, which only moves once
+  //the reservation is exhausted, or nullptr if the pages couldn't be provided.
+  T* resize_allocation(T* ptr, size_type, size_type count) noexcept {
+    if (!ptr)
+      return nullptr;
+    Header* header = header_of(ptr);
+    char* base = reinterpret_cast<char*>(header);
+    size_type needed = round_up(header_bytes() + bytes_for(count), page_size());
+
+    if (needed <= header->committed) {
+      if (needed < header->committed) {
+        decommit(base + needed, header->committed - needed);
+        header->committed = needed;
+      }
+      return ptr;
+    }
+
+    if (needed <= header->reserved) {
+      if (!commit(base + header->committed, needed - header->committed))
+        return nullptr;
+      header->committed = needed;
+      return ptr;
+    }
+
+#if defined(__linux__)
+    //Drop the unused part of the reservation so the committed pages are one mapping,
+    //then let the kernel move them into a range twice as large
+    size_type reserved = header->reserved;
+    size_type committed = header->committed;
+    if (reserved > committed)
+      munmap(base + committed, reserved - committed);
+    size_type new_reserved = needed > 2 * reserved ? needed : 2 * reserved;
+    void* moved = mremap(base, committed, new_reserved, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) {
+      void* tail = mmap(base + committed, reserved - committed, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+      if (tail == MAP_FAILED)
+        header->reserved = committed;
+      return nullptr;
+    }
+    char* new_base = static_cast<char*>(moved);
+    mprotect(new_base + needed, new_reserved - needed, PROT_NONE);
+    header = reinterpret_cast<Header*>(new_base);
+    header->reserved = new_reserved;
+    header->committed = needed;
+    return reinterpret_cast<T*>(new_base + header_bytes());
+#else
+    return nullptr;
+#endif
+  }
+
+  friend bool operator==(const VirtualMemoryAllocator&, const VirtualMemoryAllocator&) noexcept {
+    return true;
+  }
+
+  friend bool operator!=(const VirtualMemoryAllocator&, const VirtualMemoryAllocator&) noexcept {
+    return false;
+  }
+
+private:
+  struct Header {
+    size_type reserved;
+    size_type committed;
+  };
+
+  static size_type header_bytes() noexcept {
+    return alignof(T) > sizeof(Header) ? alignof(T) : sizeof(Header);
+  }
+
+  static size_type bytes_for(size_type count) noexcept {
+    return count * sizeof(T);
+  }
+
+  static size_type round_up(size_type bytes, size_type page) noexcept {
+    return (bytes + page - 1) / page * page;
+  }
+
+  static Header* header_of(T* ptr) noexcept {
+    return reinterpret_cast<Header*>(reinterpret_cast<char*>(ptr) - header_bytes());
+  }
+
+#if defined(_WIN32)
+  static size_type page_size() noexcept {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+  }
+
+  static void* reserve(size_type bytes) noexcept {
+    return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+  }
+
+  static bool commit(void* ptr, size_type bytes) noexcept {
+    return VirtualAlloc(ptr, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+  }
+
+  static void decommit(void* ptr, size_type bytes) noexcept {
+    VirtualFree(ptr, bytes, MEM_DECOMMIT);
+  }
+
+  static void release(void* ptr, size_type) noexcept {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+  }
+#else
+  static size_type page_size() noexcept {
+    return static_cast<size_type>(sysconf(_SC_PAGESIZE));
+  }
+
+  static void* reserve(size_type bytes) noexcept {
+    void* ptr = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  static bool commit(void* ptr, size_type bytes) noexcept {
+    return mprotect(ptr, bytes, PROT_READ | PROT_WRITE) == 0;
+  }
+
+  static void decommit(void* ptr, size_type bytes) noexcept {
+    madvise(ptr, bytes, MADV_DONTNEED);
+    mprotect(ptr, bytes, PROT_NONE);
+  }
+
+  static void release(void* ptr, size_type bytes) noexcept {
+    munmap(ptr, bytes);
+  }
+#endif
+
+  size_type _reservation;
+};